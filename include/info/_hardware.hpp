@@ -0,0 +1,55 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#    include <intrin.h>
+#endif
+
+namespace info::impl {
+    /// The assumed size of a cache line, used to keep data touched by
+    /// different threads apart. std::hardware_destructive_interference_size
+    /// is not used because it is not stable across compiler flags.
+    constexpr const std::size_t cache_line_size = 64;
+
+    /// Hints the CPU that the caller is busy-waiting.
+    inline void
+    cpu_relax() noexcept {
+#if defined(__GNUG__) && (defined(__x86_64__) || defined(__i386__))
+        __builtin_ia32_pause();
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        _mm_pause();
+#elif defined(__GNUG__) && (defined(__aarch64__) || defined(__arm__))
+        asm volatile("yield" ::: "memory");
+#endif
+    }
+
+    /// Exponential backoff for spin-waiting loops: spins for an exponentially
+    /// growing amount of pauses, then starts yielding the thread.
+    struct backoff {
+        void
+        operator()() noexcept {
+            if (_spins <= max_spins) {
+                for (std::uint32_t i = 0; i < _spins; ++i) cpu_relax();
+                _spins <<= 1;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+
+        void
+        reset() noexcept {
+            _spins = 1;
+        }
+
+    private:
+        constexpr const static std::uint32_t max_spins = 64;
+        std::uint32_t _spins = 1;
+    };
+}
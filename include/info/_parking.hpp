@@ -0,0 +1,103 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__linux__)
+#    include <ctime>
+#    include <linux/futex.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#else
+#    include <condition_variable>
+#    include <cstddef>
+#    include <mutex>
+#endif
+
+namespace info::impl {
+    using parking_clock = std::chrono::steady_clock;
+
+#if defined(__linux__)
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t),
+                  "futex parking requires std::atomic<std::uint32_t> to be a plain 32 bit word");
+
+    inline long
+    futex(std::atomic<std::uint32_t>& word, int op, std::uint32_t val, const timespec* timeout) noexcept {
+        return ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), op, val, timeout, nullptr, 0);
+    }
+
+    /// Blocks while `word` holds `expected`. May return spuriously.
+    inline void
+    park(std::atomic<std::uint32_t>& word, std::uint32_t expected) noexcept {
+        futex(word, FUTEX_WAIT_PRIVATE, expected, nullptr);
+    }
+
+    /// Blocks while `word` holds `expected`, at most until `deadline`. May return spuriously.
+    inline void
+    park_until(std::atomic<std::uint32_t>& word,
+               std::uint32_t expected,
+               parking_clock::time_point deadline) noexcept {
+        const auto left = deadline - parking_clock::now();
+        if (left <= parking_clock::duration::zero()) return;
+
+        const auto secs = std::chrono::duration_cast<std::chrono::seconds>(left);
+        const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(left - secs);
+        timespec timeout{};
+        timeout.tv_sec = static_cast<std::time_t>(secs.count());
+        timeout.tv_nsec = static_cast<long>(nanos.count());
+        futex(word, FUTEX_WAIT_PRIVATE, expected, &timeout);
+    }
+
+    /// Wakes every thread parked on `word`.
+    inline void
+    unpark_all(std::atomic<std::uint32_t>& word) noexcept {
+        futex(word, FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr);
+    }
+#else
+    /// Without futexes, parked threads wait on one of a fixed set of
+    /// condition variables, picked by the address of the word.
+    struct parking_bucket {
+        std::mutex mtx;
+        std::condition_variable cv;
+    };
+
+    inline parking_bucket&
+    parking_bucket_of(const void* addr) noexcept {
+        constexpr const std::size_t buckets = 64;
+        static parking_bucket table[buckets];
+        return table[(reinterpret_cast<std::uintptr_t>(addr) >> 4) % buckets];
+    }
+
+    /// Blocks while `word` holds `expected`. May return spuriously.
+    inline void
+    park(std::atomic<std::uint32_t>& word, std::uint32_t expected) noexcept {
+        auto& bucket = parking_bucket_of(&word);
+        std::unique_lock<std::mutex> lck(bucket.mtx);
+        if (word.load(std::memory_order_acquire) == expected) bucket.cv.wait(lck);
+    }
+
+    /// Blocks while `word` holds `expected`, at most until `deadline`. May return spuriously.
+    inline void
+    park_until(std::atomic<std::uint32_t>& word,
+               std::uint32_t expected,
+               parking_clock::time_point deadline) noexcept {
+        auto& bucket = parking_bucket_of(&word);
+        std::unique_lock<std::mutex> lck(bucket.mtx);
+        if (word.load(std::memory_order_acquire) == expected) bucket.cv.wait_until(lck, deadline);
+    }
+
+    /// Wakes every thread parked on `word`.
+    inline void
+    unpark_all(std::atomic<std::uint32_t>& word) noexcept {
+        auto& bucket = parking_bucket_of(&word);
+        // taking the lock orders us after any parker's check of the word
+        { std::scoped_lock lck(bucket.mtx); }
+        bucket.cv.notify_all();
+    }
+#endif
+}
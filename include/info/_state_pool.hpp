@@ -0,0 +1,247 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+// Per-thread caches of freed future shared states, so the promises and
+// continuations of a busy thread reuse the memory of the ones before them,
+// instead of going through the global allocator each time.
+//
+// States are segregated by size class: every state type of the same size,
+// rounded up to 16 bytes, shares a free list. A state freed on another thread
+// than the one which allocated it is handed back to its owner thread through
+// a lock-free stack, which the owner drains once its own free list runs dry.
+// Each free list keeps at most INFO_STATE_POOL_CAPACITY states, the rest go
+// back to the global allocator; defining it to 0 disables the caches.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include <info/_hardware.hpp>
+#include <info/_macros.hpp>
+
+#ifndef INFO_STATE_POOL_CAPACITY
+#    define INFO_STATE_POOL_CAPACITY 64
+#endif
+
+namespace info::impl {
+    struct state_cache;
+
+    /// Precedes every pooled state in memory.
+    struct alignas(alignof(std::max_align_t)) pool_block {
+        /// The cache of the thread which allocated the block, or null if the
+        /// block is not pooled.
+        state_cache* owner;
+        std::size_t size_class;
+    };
+
+    /// The free states of one thread.
+    struct state_cache {
+        constexpr const static std::size_t granule = alignof(std::max_align_t);
+        constexpr const static std::size_t classes = 32;
+        constexpr const static std::size_t capacity = INFO_STATE_POOL_CAPACITY;
+
+        /// The size class of `size` bytes, or 0 if it is too large to be pooled.
+        static std::size_t
+        size_class(std::size_t size) noexcept {
+            const auto cls = (size + granule - 1) / granule;
+            return cls <= classes ? cls : 0;
+        }
+
+        /// A block of size class `cls`, recycled if possible.
+        pool_block*
+        take(std::size_t cls) {
+            auto& list = _free[cls - 1];
+            if (!list.head) take_remote();
+            auto block = list.head;
+            if (block) {
+                list.head = next_of(block);
+                --list.size;
+            } else {
+                block = static_cast<pool_block*>(::operator new(sizeof(pool_block) + cls * granule));
+                block->owner = this;
+                block->size_class = cls;
+            }
+            ++_handed_out;
+            return block;
+        }
+
+        /// Called by the owner thread.
+        void
+        put(pool_block* block) noexcept {
+            --_handed_out;
+            recycle(block);
+        }
+
+        /// Called by any other thread: returns the block to the owner, or frees
+        /// it if the owner thread already exited.
+        void
+        put_remote(pool_block* block) noexcept {
+            if (_alive.load(std::memory_order_acquire)) {
+                auto head = _remote.load(std::memory_order_relaxed);
+                do {
+                    next_of(block) = head;
+                } while (!_remote.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_relaxed));
+            } else {
+                ::operator delete(block);
+            }
+            // only reaches zero after the owner retired, with its last block
+            if (_remote_frees.fetch_sub(1, std::memory_order_acq_rel) == 1) destroy();
+        }
+
+        /// Called when the owner thread exits. The cache itself stays until
+        /// the blocks it handed out are freed.
+        void
+        retire() noexcept {
+            for (auto& list : _free) {
+                while (list.head) {
+                    const auto next = next_of(list.head);
+                    ::operator delete(list.head);
+                    list.head = next;
+                }
+                list.size = 0;
+            }
+            _alive.store(false, std::memory_order_release);
+            free_remote();
+            // the blocks still out are the ones handed out, less the ones freed remotely
+            if (_remote_frees.fetch_add(_handed_out, std::memory_order_acq_rel) + _handed_out == 0) destroy();
+        }
+
+        /// The number of free blocks of size class `cls` kept by the owner.
+        /// Does not count the ones freed by other threads it did not take yet.
+        std::size_t
+        cached(std::size_t cls) const noexcept {
+            return _free[cls - 1].size;
+        }
+
+    private:
+        struct free_list {
+            pool_block* head = nullptr;
+            std::size_t size = 0;
+        };
+
+        /// Free blocks link through their first bytes past the header.
+        static pool_block*&
+        next_of(pool_block* block) noexcept {
+            return *reinterpret_cast<pool_block**>(block + 1);
+        }
+
+        void
+        recycle(pool_block* block) noexcept {
+            auto& list = _free[block->size_class - 1];
+            if (list.size == capacity) {
+                ::operator delete(block);
+                return;
+            }
+            next_of(block) = list.head;
+            list.head = block;
+            ++list.size;
+        }
+
+        /// Moves the blocks returned by other threads to the free lists.
+        void
+        take_remote() noexcept {
+            auto block = _remote.exchange(nullptr, std::memory_order_acquire);
+            while (block) {
+                const auto next = next_of(block);
+                recycle(block);
+                block = next;
+            }
+        }
+
+        void
+        destroy() noexcept {
+            free_remote();
+            delete this;
+        }
+
+        void
+        free_remote() noexcept {
+            auto block = _remote.exchange(nullptr, std::memory_order_acquire);
+            while (block) {
+                const auto next = next_of(block);
+                ::operator delete(block);
+                block = next;
+            }
+        }
+
+        free_list _free[classes];
+        /// Blocks handed out, less the ones the owner got back. Only touched
+        /// by the owner thread, so its own allocations need no atomics.
+        std::int64_t _handed_out = 0;
+
+        /// Blocks freed by other threads.
+        alignas(cache_line_size) std::atomic<pool_block*> _remote{nullptr};
+        /// Minus the number of blocks freed by other threads, until the owner
+        /// retires and adds what it handed out: from then on, the number of
+        /// blocks still out. The cache is destroyed when it reaches zero.
+        std::atomic<std::int64_t> _remote_frees{0};
+        std::atomic<bool> _alive{true};
+    };
+
+    /// The cache of the calling thread; null before its first allocation,
+    /// and after it retired. Trivial, so it is usable during thread exit.
+    inline thread_local state_cache* this_thread_state_cache = nullptr;
+    inline thread_local bool this_thread_state_cache_retired = false;
+
+    /// Retires the cache of the thread when it exits.
+    struct state_cache_owner {
+        ~state_cache_owner() noexcept {
+            this_thread_state_cache_retired = true;
+            if (auto cache = this_thread_state_cache) {
+                this_thread_state_cache = nullptr;
+                cache->retire();
+            }
+        }
+    };
+
+    inline state_cache*
+    this_thread_state_cache_create() {
+        if (this_thread_state_cache_retired) return nullptr;
+        thread_local state_cache_owner owner;
+        this_thread_state_cache = new state_cache;
+        return this_thread_state_cache;
+    }
+
+    /// Allocates `size` bytes for a shared state.
+    inline void*
+    allocate_state(std::size_t size) {
+        if constexpr (state_cache::capacity == 0) {
+            return ::operator new(size);
+        } else {
+            const auto cls = state_cache::size_class(size);
+            auto cache = this_thread_state_cache;
+            if (INFO_UNLIKELY_(cls == 0 || (!cache && !(cache = this_thread_state_cache_create())))) {
+                const auto block = static_cast<pool_block*>(::operator new(sizeof(pool_block) + size));
+                block->owner = nullptr;
+                block->size_class = 0;
+                return block + 1;
+            }
+
+            return cache->take(cls) + 1;
+        }
+    }
+
+    /// Frees a shared state allocated by allocate_state, on any thread.
+    inline void
+    deallocate_state(void* ptr) noexcept {
+        if constexpr (state_cache::capacity == 0) {
+            ::operator delete(ptr);
+        } else {
+            const auto block = static_cast<pool_block*>(ptr) - 1;
+            const auto owner = block->owner;
+            if (!owner) {
+                ::operator delete(block);
+                return;
+            }
+            if (owner == this_thread_state_cache) {
+                owner->put(block);
+            } else {
+                owner->put_remote(block);
+            }
+        }
+    }
+}
@@ -0,0 +1,167 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+// A minimal io_uring driver on the raw system calls, so no liburing is needed.
+// Only defined if the kernel headers know io_uring; whether the running kernel
+// supports it is found out when a ring is set up.
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#    define INFO_HAS_URING_ 1
+
+#    include <algorithm>
+#    include <cerrno>
+#    include <cstddef>
+#    include <cstdint>
+#    include <cstring>
+
+#    include <linux/io_uring.h>
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+
+namespace info::impl {
+    /// A single-threaded io_uring instance: one submission and one completion queue.
+    struct uring {
+        /// Sets up a ring with room for `entries` submissions.
+        /// Returns false if the kernel does not support io_uring.
+        bool
+        init(unsigned entries) noexcept {
+            io_uring_params params{};
+            const auto fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+            if (fd < 0) return false;
+            _fd = fd;
+
+            _sq_size = params.sq_off.array + params.sq_entries * sizeof(std::uint32_t);
+            _cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            const auto single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single_mmap) _sq_size = _cq_size = std::max(_sq_size, _cq_size);
+
+            _sq_ring = map(_sq_size, IORING_OFF_SQ_RING);
+            if (!_sq_ring) return fail();
+            _cq_ring = single_mmap ? _sq_ring : map(_cq_size, IORING_OFF_CQ_RING);
+            if (!_cq_ring) return fail();
+            _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+            _sqes = static_cast<io_uring_sqe*>(map(_sqes_size, IORING_OFF_SQES));
+            if (!_sqes) return fail();
+
+            _sq_head = at<std::uint32_t>(_sq_ring, params.sq_off.head);
+            _sq_tail = at<std::uint32_t>(_sq_ring, params.sq_off.tail);
+            _sq_mask = *at<std::uint32_t>(_sq_ring, params.sq_off.ring_mask);
+            _sq_entries = *at<std::uint32_t>(_sq_ring, params.sq_off.ring_entries);
+            _sq_array = at<std::uint32_t>(_sq_ring, params.sq_off.array);
+            _cq_head = at<std::uint32_t>(_cq_ring, params.cq_off.head);
+            _cq_tail = at<std::uint32_t>(_cq_ring, params.cq_off.tail);
+            _cq_mask = *at<std::uint32_t>(_cq_ring, params.cq_off.ring_mask);
+            _cqes = at<io_uring_cqe>(_cq_ring, params.cq_off.cqes);
+            _local_tail = *_sq_tail;
+            return true;
+        }
+
+        /// A cleared submission entry, or null if the submission queue is full.
+        io_uring_sqe*
+        get_sqe() noexcept {
+            const auto head = __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+            if (_local_tail - head == _sq_entries) return nullptr;
+
+            const auto idx = _local_tail & _sq_mask;
+            _sq_array[idx] = idx;
+            ++_local_tail;
+            auto sqe = &_sqes[idx];
+            std::memset(sqe, 0, sizeof *sqe);
+            return sqe;
+        }
+
+        /// Submits the prepared entries in one system call, and waits until
+        /// at least `wait` completions are available.
+        /// Returns the number submitted, or -errno.
+        int
+        submit(unsigned wait) noexcept {
+            const auto to_submit = _local_tail - *_sq_tail;
+            __atomic_store_n(_sq_tail, _local_tail, __ATOMIC_RELEASE);
+            const auto flags = wait != 0 ? IORING_ENTER_GETEVENTS : 0U;
+            const auto ret = ::syscall(__NR_io_uring_enter, _fd, to_submit, wait, flags, nullptr, 0);
+            return ret < 0 ? -errno : static_cast<int>(ret);
+        }
+
+        /// Calls `fn` with every available completion, and consumes them.
+        template<class Fn>
+        unsigned
+        reap(Fn&& fn) {
+            auto head = *_cq_head;
+            const auto tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+            unsigned n = 0;
+            for (; head != tail; ++head, ++n) {
+                const auto cqe = _cqes[head & _cq_mask];
+                // free the slot before the callback, which may submit again
+                __atomic_store_n(_cq_head, head + 1, __ATOMIC_RELEASE);
+                fn(cqe);
+            }
+            return n;
+        }
+
+        uring() noexcept = default;
+
+        uring(const uring& cp) = delete;
+        uring& operator=(const uring& cp) = delete;
+
+        ~uring() noexcept {
+            unmap();
+        }
+
+    private:
+        void*
+        map(std::size_t size, std::uint64_t offset) const noexcept {
+            const auto ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                    _fd, static_cast<off_t>(offset));
+            return ptr == MAP_FAILED ? nullptr : ptr;
+        }
+
+        template<class T>
+        static T*
+        at(void* base, std::uint32_t offset) noexcept {
+            return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+        }
+
+        bool
+        fail() noexcept {
+            unmap();
+            return false;
+        }
+
+        void
+        unmap() noexcept {
+            if (_sqes) ::munmap(_sqes, _sqes_size);
+            if (_cq_ring && _cq_ring != _sq_ring) ::munmap(_cq_ring, _cq_size);
+            if (_sq_ring) ::munmap(_sq_ring, _sq_size);
+            if (_fd >= 0) ::close(_fd);
+            _sqes = nullptr;
+            _cq_ring = _sq_ring = nullptr;
+            _fd = -1;
+        }
+
+        int _fd = -1;
+        void* _sq_ring = nullptr;
+        void* _cq_ring = nullptr;
+        io_uring_sqe* _sqes = nullptr;
+        std::size_t _sq_size = 0;
+        std::size_t _cq_size = 0;
+        std::size_t _sqes_size = 0;
+
+        std::uint32_t* _sq_head = nullptr;
+        std::uint32_t* _sq_tail = nullptr;
+        std::uint32_t* _sq_array = nullptr;
+        std::uint32_t _sq_mask = 0;
+        std::uint32_t _sq_entries = 0;
+        /// Entries prepared, but not yet published to the kernel.
+        std::uint32_t _local_tail = 0;
+
+        std::uint32_t* _cq_head = nullptr;
+        std::uint32_t* _cq_tail = nullptr;
+        std::uint32_t _cq_mask = 0;
+        io_uring_cqe* _cqes = nullptr;
+    };
+}
+
+#endif
@@ -0,0 +1,101 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <info/executor.hpp>
+#include <info/future.hpp>
+
+namespace info {
+    namespace impl {
+        /// The shared state of an async call, which is its task record as well:
+        /// the function and its arguments are stored in the state, so the call
+        /// takes one allocation.
+        template<class R, class Fn, class... Args>
+        struct async_state final : future_state<R> {
+            /// Hands the state to `exec`. The task holds a reference until it ran.
+            void
+            schedule(executor& exec) {
+                INFO_TRACE_FUTURE_(scheduled, this);
+                this->add_ref();
+                try {
+                    exec.execute([this] {
+                        run();
+                        this->release();
+                    });
+                } catch (...) {
+                    this->release();
+                    throw;
+                }
+            }
+
+            template<class Fn_, class... Args_>
+            explicit async_state(Fn_&& fn, Args_&&... args)
+                 : future_state<R>(),
+                   _fn(std::forward<Fn_>(fn)),
+                   _args(std::forward<Args_>(args)...) { }
+
+        private:
+            void
+            run() noexcept {
+                INFO_TRACE_FUTURE_(started, this);
+                try {
+                    this->put_value(std::apply(std::move(_fn), std::move(_args)));
+                } catch (...) {
+                    this->put_exception(std::current_exception());
+                }
+                INFO_TRACE_FUTURE_(finished, this);
+            }
+
+            Fn _fn;
+            std::tuple<Args...> _args;
+        };
+
+        template<class Fn, class... Args>
+        using async_result_t = std::decay_t<std::invoke_result_t<std::decay_t<Fn>, std::decay_t<Args>...>>;
+    }
+
+    /**
+     * \brief Calls `fn` with `args` on `exec`, and returns a future of the result.
+     *
+     * The function and the arguments are decay-copied into the shared state of
+     * the returned future, which also serves as the task given to the
+     * executor: besides what the executor needs, the call does one allocation.
+     * If `fn` throws, the exception is stored in the future.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    template<class Fn, class... Args>
+    future<impl::async_result_t<Fn, Args...>>
+    async(executor& exec, Fn&& fn, Args&&... args) {
+        using result_type = impl::async_result_t<Fn, Args...>;
+        static_assert(!std::is_void_v<result_type>, "async(): info::future<void> is not supported");
+        using state = impl::async_state<result_type, std::decay_t<Fn>, std::decay_t<Args>...>;
+
+        auto st = impl::state_ptr<state>::make(std::forward<Fn>(fn), std::forward<Args>(args)...);
+        st->schedule(exec);
+        return impl::future_access::make_future(impl::state_ptr<impl::future_state<result_type>>(std::move(st)));
+    }
+
+    /**
+     * \brief Calls `fn` with `args` on the default executor, and returns a future of the result.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    template<class Fn,
+             class... Args,
+             class = std::enable_if_t<!std::is_base_of_v<executor, std::decay_t<Fn>>>>
+    future<impl::async_result_t<Fn, Args...>>
+    async(Fn&& fn, Args&&... args) {
+        return info::async(default_executor(), std::forward<Fn>(fn), std::forward<Args>(args)...);
+    }
+}
@@ -0,0 +1,512 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <info/_hardware.hpp>
+#include <info/_macros.hpp>
+#include <info/byte_ring.hpp>
+#include <info/fail.hpp>
+
+namespace info {
+    /// What an async_logger does when a thread's buffer is full.
+    enum class overflow_policy {
+        drop, ///< Discard the record and count it as dropped
+        block ///< Wait for the background thread to make space
+    };
+
+    struct async_logger_options {
+        /// Size of the buffer preallocated for each logging thread, in bytes.
+        std::size_t buffer_size = 64 * 1024;
+        overflow_policy overflow = overflow_policy::drop;
+        /// How long the background thread sleeps when there is nothing to write.
+        std::chrono::microseconds poll_interval{1000};
+    };
+
+    namespace impl {
+        struct log_value {
+            enum class kind {
+                Signed,
+                Unsigned,
+                Floating,
+                Bool,
+                Char,
+                Pointer,
+                String
+            };
+
+            kind _kind;
+            union {
+                long long _signed;
+                unsigned long long _unsigned;
+                double _floating;
+                bool _bool;
+                char _char;
+                const void* _pointer;
+                std::string_view _string;
+            };
+
+            log_value() noexcept
+                 : _kind(kind::Signed),
+                   _signed(0) { }
+        };
+
+        template<class T>
+        inline void
+        log_write(std::byte*& at, const T& value) noexcept {
+            std::memcpy(at, &value, sizeof(T));
+            at += sizeof(T);
+        }
+
+        template<class T>
+        inline T
+        log_read(const std::byte*& at) noexcept {
+            T value;
+            std::memcpy(&value, at, sizeof(T));
+            at += sizeof(T);
+            return value;
+        }
+
+        template<class T, class = void>
+        struct log_arg {
+            static_assert(fail_v<T>, "async_logger: unsupported argument type");
+        };
+
+        template<class T>
+        struct log_arg<T, std::enable_if_t<std::is_arithmetic_v<T>>> {
+            static std::size_t
+            size(const T&) noexcept {
+                return sizeof(T);
+            }
+
+            static void
+            encode(std::byte*& at, const T& value) noexcept {
+                log_write(at, value);
+            }
+
+            static log_value
+            decode(const std::byte*& at) noexcept {
+                log_value val;
+                const auto value = log_read<T>(at);
+                if constexpr (std::is_same_v<T, bool>) {
+                    val._kind = log_value::kind::Bool;
+                    val._bool = value;
+                } else if constexpr (std::is_same_v<T, char>) {
+                    val._kind = log_value::kind::Char;
+                    val._char = value;
+                } else if constexpr (std::is_floating_point_v<T>) {
+                    val._kind = log_value::kind::Floating;
+                    val._floating = static_cast<double>(value);
+                } else if constexpr (std::is_signed_v<T>) {
+                    val._kind = log_value::kind::Signed;
+                    val._signed = value;
+                } else {
+                    val._kind = log_value::kind::Unsigned;
+                    val._unsigned = value;
+                }
+                return val;
+            }
+        };
+
+        template<class T>
+        struct log_arg<T*, std::enable_if_t<!std::is_same_v<std::remove_cv_t<T>, char>>> {
+            static std::size_t
+            size(T*) noexcept {
+                return sizeof(const void*);
+            }
+
+            static void
+            encode(std::byte*& at, T* value) noexcept {
+                log_write(at, static_cast<const void*>(value));
+            }
+
+            static log_value
+            decode(const std::byte*& at) noexcept {
+                log_value val;
+                val._kind = log_value::kind::Pointer;
+                val._pointer = log_read<const void*>(at);
+                return val;
+            }
+        };
+
+        /// Strings are copied into the record, as their lifetime is unknown.
+        struct log_string_arg {
+            static std::size_t
+            size(std::string_view value) noexcept {
+                return sizeof(std::size_t) + value.size();
+            }
+
+            static void
+            encode(std::byte*& at, std::string_view value) noexcept {
+                log_write(at, value.size());
+                std::memcpy(at, value.data(), value.size());
+                at += value.size();
+            }
+
+            static log_value
+            decode(const std::byte*& at) noexcept {
+                log_value val;
+                val._kind = log_value::kind::String;
+                const auto len = log_read<std::size_t>(at);
+                val._string = {reinterpret_cast<const char*>(at), len};
+                at += len;
+                return val;
+            }
+        };
+
+        template<>
+        struct log_arg<const char*> : log_string_arg { };
+        template<>
+        struct log_arg<char*> : log_string_arg { };
+        template<>
+        struct log_arg<std::string_view> : log_string_arg { };
+        template<>
+        struct log_arg<std::string> : log_string_arg { };
+
+        inline void
+        format_value(std::string& out, const log_value& val) {
+            char buf[32];
+            switch (val._kind) {
+            case log_value::kind::Signed:
+                out.append(buf, std::to_chars(buf, buf + sizeof buf, val._signed).ptr);
+                return;
+            case log_value::kind::Unsigned:
+                out.append(buf, std::to_chars(buf, buf + sizeof buf, val._unsigned).ptr);
+                return;
+            case log_value::kind::Floating: {
+                const auto len = std::snprintf(buf, sizeof buf, "%g", val._floating);
+                out.append(buf, static_cast<std::size_t>(len));
+                return;
+            }
+            case log_value::kind::Bool:
+                out.append(val._bool ? "true" : "false");
+                return;
+            case log_value::kind::Char:
+                out.push_back(val._char);
+                return;
+            case log_value::kind::Pointer: {
+                const auto len = std::snprintf(buf, sizeof buf, "%p", val._pointer);
+                out.append(buf, static_cast<std::size_t>(len));
+                return;
+            }
+            case log_value::kind::String:
+                out.append(val._string);
+                return;
+            }
+            INFO_UNREACHABLE;
+        }
+
+        /// Substitutes each `{}` in `fmt` with the next value. `{{` and `}}`
+        /// produce literal braces. Surplus placeholders are kept as-is.
+        inline void
+        format_to(std::string& out, const char* fmt, const log_value* values, std::size_t count) {
+            std::size_t next = 0;
+            for (auto it = fmt; *it != '\0'; ++it) {
+                if (it[0] == '{' && it[1] == '{') {
+                    out.push_back('{');
+                    ++it;
+                } else if (it[0] == '}' && it[1] == '}') {
+                    out.push_back('}');
+                    ++it;
+                } else if (it[0] == '{' && it[1] == '}' && next < count) {
+                    format_value(out, values[next++]);
+                    ++it;
+                } else {
+                    out.push_back(*it);
+                }
+            }
+        }
+
+        using log_formatter = void (*)(std::string&, const char*, const std::byte*);
+
+        template<class... Args>
+        void
+        format_record(std::string& out, const char* fmt, const std::byte* args) {
+            // braced initializers are evaluated in order, so decoding is sequenced
+            const std::array<log_value, sizeof...(Args)> values{log_arg<Args>::decode(args)...};
+            format_to(out, fmt, values.data(), values.size());
+            out.push_back('\n');
+        }
+
+        struct log_producer {
+            explicit log_producer(std::size_t buffer_size)
+                 : _ring(buffer_size) { }
+
+            byte_ring _ring;
+            std::atomic<std::size_t> _dropped{0};
+            /// Set when the owning thread exits.
+            std::atomic<bool> _retired{false};
+            /// Set when the logger is destroyed.
+            std::atomic<bool> _orphaned{false};
+        };
+
+        /// The buffers of the calling thread for each logger it logs to.
+        struct log_thread_cache {
+            struct entry {
+                std::uint64_t _logger;
+                std::shared_ptr<log_producer> _producer;
+            };
+
+            static log_thread_cache&
+            get() {
+                thread_local log_thread_cache cache;
+                return cache;
+            }
+
+            log_producer*
+            find(std::uint64_t logger) const noexcept {
+                for (const auto& e : _entries)
+                    if (e._logger == logger) return e._producer.get();
+                return nullptr;
+            }
+
+            void
+            add(std::uint64_t logger, std::shared_ptr<log_producer> producer) {
+                _entries.erase(std::remove_if(_entries.begin(), _entries.end(), [](const entry& e) {
+                                   return e._producer->_orphaned.load(std::memory_order_relaxed);
+                               }),
+                               _entries.end());
+                _entries.push_back({logger, std::move(producer)});
+            }
+
+            ~log_thread_cache() noexcept {
+                for (auto& e : _entries) e._producer->_retired.store(true, std::memory_order_release);
+            }
+
+        private:
+            std::vector<entry> _entries;
+        };
+    }
+
+    /**
+     * \brief A logger which moves formatting and writing off the calling thread.
+     *
+     * Calling `log` only copies the format string pointer and the raw
+     * arguments into a buffer preallocated for the calling thread. A background
+     * thread drains all buffers, formats the records, and hands them to the sink
+     * in batches. Records of one thread are written in order; records of
+     * different threads may interleave arbitrarily.
+     *
+     * Format strings use `{}` as placeholders and must outlive the logger,
+     * usually by being string literals. Supported arguments are arithmetic types,
+     * pointers, and strings; strings are copied into the record.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct async_logger {
+        using sink_type = std::function<void(std::string_view)>;
+
+        /**
+         * \brief Logs a record. Does not format nor write anything.
+         *
+         * Records which could never fit in a thread's buffer, about half of
+         * `buffer_size`, are dropped under either overflow policy, as waiting
+         * would not make room for them. Long strings are the usual cause.
+         *
+         * \return Whether the record was stored. False if it was dropped,
+         *         either because of the overflow policy, or because it is
+         *         too large for the buffer.
+         */
+        template<class... Args>
+        bool
+        log(const char* fmt, const Args&... args) {
+            auto producer = this_thread_producer();
+
+            const auto size = sizeof(impl::log_formatter) + sizeof(const char*)
+                              + (std::size_t{0} + ... + impl::log_arg<std::decay_t<Args>>::size(args));
+            if (INFO_UNLIKELY_(size > producer->_ring.max_record_size())) {
+                producer->_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            auto buf = producer->_ring.reserve(size);
+            if (INFO_UNLIKELY_(!buf)) {
+                buf = wait_for_space(*producer, size);
+                if (!buf) return false;
+            }
+
+            auto at = buf.data();
+            impl::log_write(at, &impl::format_record<std::decay_t<Args>...>);
+            impl::log_write(at, fmt);
+            (impl::log_arg<std::decay_t<Args>>::encode(at, args), ...);
+            producer->_ring.commit();
+            return true;
+        }
+
+        /**
+         * \brief Blocks until all records logged before the call are written.
+         */
+        void
+        flush() {
+            std::unique_lock lck(_mtx);
+            const auto target = ++_flush_requested;
+            _cv.notify_one();
+            _flushed_cv.wait(lck, [this, target] { return _flush_done >= target; });
+        }
+
+        /**
+         * \brief The number of records dropped so far.
+         */
+        INFO_NODISCARD_JUST
+        std::size_t
+        dropped() const {
+            std::scoped_lock lck(_mtx);
+            auto dropped = _dropped;
+            for (const auto& producer : _producers) dropped += producer->_dropped.load(std::memory_order_relaxed);
+            return dropped;
+        }
+
+        explicit async_logger(sink_type sink, async_logger_options opts = {})
+             : _id(next_id()),
+               _opts(opts),
+               _sink(std::move(sink)),
+               _worker([this] { run(); }) { }
+
+        explicit async_logger(std::FILE* out = stderr, async_logger_options opts = {})
+             : async_logger(
+                      [out](std::string_view batch) {
+                          std::fwrite(batch.data(), 1, batch.size(), out);
+                          std::fflush(out);
+                      },
+                      opts) { }
+
+        async_logger(const async_logger& cp) = delete;
+        async_logger& operator=(const async_logger& cp) = delete;
+
+        ~async_logger() noexcept {
+            {
+                std::scoped_lock lck(_mtx);
+                _stop = true;
+            }
+            _cv.notify_one();
+            _worker.join();
+        }
+
+    private:
+        static std::uint64_t
+        next_id() noexcept {
+            static std::atomic<std::uint64_t> ids{0};
+            return ++ids;
+        }
+
+        impl::log_producer*
+        this_thread_producer() {
+            auto& cache = impl::log_thread_cache::get();
+            if (auto producer = cache.find(_id); INFO_LIKELY_(producer != nullptr)) return producer;
+
+            auto producer = std::make_shared<impl::log_producer>(_opts.buffer_size);
+            {
+                std::scoped_lock lck(_mtx);
+                _producers.push_back(producer);
+            }
+            cache.add(_id, producer);
+            return producer.get();
+        }
+
+        byte_ring::span
+        wait_for_space(impl::log_producer& producer, std::size_t size) {
+            if (_opts.overflow == overflow_policy::drop) {
+                producer._dropped.fetch_add(1, std::memory_order_relaxed);
+                return {};
+            }
+
+            _cv.notify_one();
+            impl::backoff wait;
+            byte_ring::span buf;
+            while (!(buf = producer._ring.reserve(size))) wait();
+            return buf;
+        }
+
+        /// Formats every record in the buffer into the batch.
+        static void
+        drain(impl::log_producer& producer, std::string& batch) {
+            for (auto rec = producer._ring.peek(); rec; rec = producer._ring.peek()) {
+                const std::byte* at = rec.data();
+                const auto formatter = impl::log_read<impl::log_formatter>(at);
+                const auto fmt = impl::log_read<const char*>(at);
+                formatter(batch, fmt, at);
+                producer._ring.release();
+            }
+        }
+
+        void
+        run() {
+            std::string batch;
+            std::unique_lock lck(_mtx);
+            for (;;) {
+                const auto stopping = _stop;
+                const auto flush_target = _flush_requested;
+
+                for (auto it = _producers.begin(); it != _producers.end();) {
+                    auto& producer = **it;
+                    // read retirement first: a retired thread logs nothing after it
+                    const auto retired = producer._retired.load(std::memory_order_acquire);
+                    drain(producer, batch);
+                    if (retired) {
+                        _dropped += producer._dropped.load(std::memory_order_relaxed);
+                        it = _producers.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+
+                if (!batch.empty()) {
+                    lck.unlock();
+                    _sink(batch);
+                    batch.clear();
+                    lck.lock();
+                    // there may be more, do not sleep until a pass finds nothing
+                    if (!stopping && flush_target == _flush_requested) continue;
+                }
+
+                if (flush_target != _flush_done) {
+                    _flush_done = flush_target;
+                    _flushed_cv.notify_all();
+                }
+                if (stopping) break;
+
+                _cv.wait_for(lck, _opts.poll_interval, [this, flush_target] {
+                    return _stop || _flush_requested != flush_target;
+                });
+            }
+
+            for (auto& producer : _producers) producer->_orphaned.store(true, std::memory_order_relaxed);
+        }
+
+        const std::uint64_t _id;
+        const async_logger_options _opts;
+        sink_type _sink;
+
+        mutable std::mutex _mtx;
+        std::condition_variable _cv;
+        std::condition_variable _flushed_cv;
+        std::vector<std::shared_ptr<impl::log_producer>> _producers;
+        std::size_t _dropped = 0;
+        std::uint64_t _flush_requested = 0;
+        std::uint64_t _flush_done = 0;
+        bool _stop = false;
+
+        std::thread _worker;
+    };
+}
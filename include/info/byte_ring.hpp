@@ -0,0 +1,282 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include <info/_hardware.hpp>
+#include <info/_macros.hpp>
+
+namespace info {
+    /**
+     * \brief A single-producer single-consumer ring of variable-length byte records.
+     *
+     * Records are stored inline in one contiguous buffer allocated at construction,
+     * each prefixed by its length. A record never wraps around the end of the buffer,
+     * so both sides always see it as one contiguous range of bytes.
+     * The producer reserves space, writes the record in place, then commits it;
+     * the consumer peeks at the oldest record, reads it in place, then releases it.
+     * Neither side allocates or copies.
+     *
+     * Exactly one thread may act as producer and one as consumer at a time.
+     * Record payloads are aligned to `byte_ring::record_alignment` bytes.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct byte_ring {
+        /**
+         * \brief A mutable view of a record's payload inside the ring.
+         *
+         * An empty span signals that the operation could not be performed.
+         */
+        struct span {
+            INFO_NODISCARD_JUST
+            constexpr std::byte*
+            data() const noexcept {
+                return _data;
+            }
+
+            INFO_NODISCARD_JUST
+            constexpr std::size_t
+            size() const noexcept {
+                return _size;
+            }
+
+            INFO_NODISCARD_JUST
+            constexpr std::byte*
+            begin() const noexcept {
+                return _data;
+            }
+
+            INFO_NODISCARD_JUST
+            constexpr std::byte*
+            end() const noexcept {
+                return _data + _size;
+            }
+
+            constexpr explicit operator bool() const noexcept {
+                return _data != nullptr;
+            }
+
+            constexpr span() noexcept = default;
+            constexpr span(std::byte* data, std::size_t size) noexcept
+                 : _data(data),
+                   _size(size) { }
+
+        private:
+            std::byte* _data = nullptr;
+            std::size_t _size = 0;
+        };
+
+        constexpr const static std::size_t record_alignment = alignof(std::uint64_t);
+
+        /**
+         * \brief Reserves space for a record of `n` bytes.
+         *
+         * Returns an empty span if the ring is currently too full to hold
+         * the record. The reservation is only made visible to the consumer
+         * when `commit` is called. At most one reservation may be pending.
+         *
+         * \throws std::length_error if `n` exceeds `max_record_size()`
+         */
+        INFO_NODISCARD("The reserved space must be written and committed")
+        span
+        reserve(std::size_t n) {
+            assert(_reserved == npos && "byte_ring::reserve(): a reservation is already pending");
+            if (n > max_record_size())
+                throw std::length_error("byte_ring::reserve(): record exceeds max_record_size()");
+
+            const auto total = record_size(n);
+            const auto w = _write.load(std::memory_order_relaxed);
+            const auto pos = w & _mask;
+            const auto contiguous = _capacity - pos;
+            // if the record does not fit before the end of the buffer, the rest
+            // of the buffer is skipped and the record is placed at its start
+            const auto skip = total <= contiguous ? 0 : contiguous;
+
+            if (_capacity - (w - _read_cache) < skip + total) {
+                _read_cache = _read.load(std::memory_order_acquire);
+                if (_capacity - (w - _read_cache) < skip + total) return {};
+            }
+
+            _reserved = n;
+            _reserved_skip = skip;
+            return {_buffer.get() + (skip == 0 ? pos : 0) + header_size, n};
+        }
+
+        /**
+         * \brief Publishes the first `n` bytes of the pending reservation.
+         */
+        void
+        commit(std::size_t n) {
+            assert(_reserved != npos && "byte_ring::commit(): no reservation is pending");
+            assert(n <= _reserved && "byte_ring::commit(): committing more than reserved");
+
+            const auto w = _write.load(std::memory_order_relaxed);
+            const auto pos = w & _mask;
+            if (_reserved_skip != 0) {
+                write_header(pos, wrap_marker);
+                write_header(0, n);
+            } else {
+                write_header(pos, n);
+            }
+            _write.store(w + _reserved_skip + record_size(n), std::memory_order_release);
+            _reserved = npos;
+        }
+
+        /**
+         * \brief Publishes the whole pending reservation.
+         */
+        void
+        commit() {
+            commit(_reserved);
+        }
+
+        /**
+         * \brief Copies a record of `n` bytes into the ring.
+         *
+         * \return Whether there was enough space to hold the record.
+         */
+        bool
+        try_push(const void* data, std::size_t n) {
+            auto buf = reserve(n);
+            if (!buf) return false;
+            if (n != 0) std::memcpy(buf.data(), data, n);
+            commit(n);
+            return true;
+        }
+
+        /**
+         * \brief Returns the oldest record in the ring, or an empty span if
+         * there are none.
+         *
+         * The record stays in the ring until `release` is called.
+         */
+        INFO_NODISCARD_JUST
+        span
+        peek() {
+            const auto r = _read.load(std::memory_order_relaxed);
+            if (r == _write_cache) {
+                _write_cache = _write.load(std::memory_order_acquire);
+                if (r == _write_cache) return {};
+            }
+
+            auto pos = r & _mask;
+            auto len = read_header(pos);
+            if (len == wrap_marker) {
+                pos = 0;
+                len = read_header(0);
+            }
+            return {_buffer.get() + pos + header_size, static_cast<std::size_t>(len)};
+        }
+
+        /**
+         * \brief Removes the oldest record from the ring.
+         *
+         * Must only be called after `peek` returned a non-empty span.
+         */
+        void
+        release() {
+            const auto r = _read.load(std::memory_order_relaxed);
+            assert(r != _write_cache && "byte_ring::release(): ring is empty");
+
+            const auto pos = r & _mask;
+            auto len = read_header(pos);
+            std::size_t skip = 0;
+            if (len == wrap_marker) {
+                skip = _capacity - pos;
+                len = read_header(0);
+            }
+            _read.store(r + skip + record_size(static_cast<std::size_t>(len)),
+                        std::memory_order_release);
+        }
+
+        INFO_NODISCARD_JUST
+        bool
+        empty() const noexcept {
+            return _read.load(std::memory_order_acquire) == _write.load(std::memory_order_acquire);
+        }
+
+        INFO_NODISCARD_JUST
+        std::size_t
+        capacity() const noexcept {
+            return _capacity;
+        }
+
+        /**
+         * \brief The largest record the ring is guaranteed to fit once empty.
+         */
+        INFO_NODISCARD_JUST
+        std::size_t
+        max_record_size() const noexcept {
+            return _capacity / 2 - header_size;
+        }
+
+        /**
+         * \brief Creates a ring with a buffer of at least `capacity` bytes.
+         *
+         * The capacity is rounded up to a power of two.
+         */
+        explicit byte_ring(std::size_t capacity)
+             : _buffer(std::make_unique<std::byte[]>(round_capacity(capacity))),
+               _capacity(round_capacity(capacity)),
+               _mask(_capacity - 1) { }
+
+        byte_ring(const byte_ring& cp) = delete;
+        byte_ring& operator=(const byte_ring& cp) = delete;
+
+    private:
+        using header_type = std::uint64_t;
+        constexpr const static std::size_t header_size = sizeof(header_type);
+        constexpr const static header_type wrap_marker = ~header_type{0};
+        constexpr const static std::size_t npos = ~std::size_t{0};
+
+        constexpr static std::size_t
+        record_size(std::size_t n) noexcept {
+            return (header_size + n + record_alignment - 1) & ~(record_alignment - 1);
+        }
+
+        constexpr static std::size_t
+        round_capacity(std::size_t n) noexcept {
+            std::size_t cap = 4 * header_size;
+            while (cap < n) cap <<= 1;
+            return cap;
+        }
+
+        void
+        write_header(std::size_t pos, header_type value) noexcept {
+            std::memcpy(_buffer.get() + pos, &value, header_size);
+        }
+
+        header_type
+        read_header(std::size_t pos) const noexcept {
+            header_type value;
+            std::memcpy(&value, _buffer.get() + pos, header_size);
+            return value;
+        }
+
+        // shared, read-only
+        std::unique_ptr<std::byte[]> _buffer;
+        std::size_t _capacity;
+        std::size_t _mask;
+
+        // producer side
+        alignas(impl::cache_line_size) std::atomic<std::size_t> _write{0};
+        std::size_t _read_cache = 0;
+        std::size_t _reserved = npos;
+        std::size_t _reserved_skip = 0;
+
+        // consumer side
+        alignas(impl::cache_line_size) std::atomic<std::size_t> _read{0};
+        std::size_t _write_cache = 0;
+    };
+}
@@ -0,0 +1,189 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <utility>
+
+#include <info/_macros.hpp>
+
+namespace info {
+    /**
+     * \brief Thrown, or stored in futures, when an operation was cancelled.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct operation_cancelled final : std::exception {
+        const char*
+        what() const noexcept override {
+            return "operation cancelled";
+        }
+    };
+
+    /**
+     * \brief Tag type for creating a cancellation_source which is cancelled
+     * when a future using its token is abandoned.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct cancel_on_abandon_t {
+        explicit cancel_on_abandon_t() = default;
+    };
+    /**
+     * \brief Passed to cancellation_source to request cancellation once a
+     * pending future observing its token is destroyed without being consumed.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    inline constexpr cancel_on_abandon_t cancel_on_abandon{};
+
+    namespace impl {
+        struct state_base;
+
+        struct cancel_state {
+            void
+            add_ref() noexcept {
+                _refs.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void
+            release() noexcept {
+                if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+            }
+
+            explicit cancel_state(bool on_abandon) noexcept
+                 : _refs(1),
+                   _cancelled(false),
+                   _on_abandon(on_abandon) { }
+
+            std::atomic<unsigned> _refs;
+            std::atomic<bool> _cancelled;
+            const bool _on_abandon;
+        };
+
+        /// A counted reference to a cancel_state, shared by sources and tokens.
+        struct cancel_ref {
+            cancel_ref() noexcept
+                 : _state(nullptr) { }
+            explicit cancel_ref(cancel_state* state) noexcept
+                 : _state(state) { }
+
+            cancel_ref(const cancel_ref& cp) noexcept
+                 : _state(cp._state) {
+                if (_state) _state->add_ref();
+            }
+            cancel_ref&
+            operator=(const cancel_ref& cp) noexcept {
+                cancel_ref(cp).swap(*this);
+                return *this;
+            }
+
+            cancel_ref(cancel_ref&& mv) noexcept
+                 : _state(std::exchange(mv._state, nullptr)) { }
+            cancel_ref&
+            operator=(cancel_ref&& mv) noexcept {
+                cancel_ref(std::move(mv)).swap(*this);
+                return *this;
+            }
+
+            void
+            swap(cancel_ref& other) noexcept {
+                std::swap(_state, other._state);
+            }
+
+            ~cancel_ref() noexcept {
+                if (_state) _state->release();
+            }
+
+            cancel_state* _state;
+        };
+    }
+
+    /**
+     * \brief Observes whether cancellation was requested through a cancellation_source.
+     *
+     * Checking a token is a single atomic load, so producers can poll it in
+     * their loops. A default constructed token is never cancelled.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct cancellation_token {
+        INFO_NODISCARD_JUST
+        bool
+        cancelled() const noexcept {
+            return _ref._state && _ref._state->_cancelled.load(std::memory_order_acquire);
+        }
+
+        /// Throws operation_cancelled if cancellation was requested.
+        void
+        throw_if_cancelled() const {
+            if (cancelled()) throw operation_cancelled();
+        }
+
+        INFO_NODISCARD_JUST
+        bool
+        can_be_cancelled() const noexcept {
+            return _ref._state != nullptr;
+        }
+
+        cancellation_token() noexcept = default;
+
+    private:
+        friend struct cancellation_source;
+        friend struct impl::state_base;
+
+        explicit cancellation_token(impl::cancel_ref ref) noexcept
+             : _ref(std::move(ref)) { }
+
+        /// Requests cancellation if the source asked for it on abandonment.
+        void
+        abandon() const noexcept {
+            if (_ref._state && _ref._state->_on_abandon)
+                _ref._state->_cancelled.store(true, std::memory_order_release);
+        }
+
+        impl::cancel_ref _ref;
+    };
+
+    /**
+     * \brief Requests cancellation of the operations holding its tokens.
+     *
+     * Copies of a source refer to the same cancellation request.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct cancellation_source {
+        void
+        cancel() noexcept {
+            _ref._state->_cancelled.store(true, std::memory_order_release);
+        }
+
+        INFO_NODISCARD_JUST
+        bool
+        cancelled() const noexcept {
+            return _ref._state->_cancelled.load(std::memory_order_acquire);
+        }
+
+        INFO_NODISCARD_JUST
+        cancellation_token
+        token() const noexcept {
+            return cancellation_token(_ref);
+        }
+
+        cancellation_source()
+             : _ref(new impl::cancel_state(false)) { }
+        explicit cancellation_source(cancel_on_abandon_t)
+             : _ref(new impl::cancel_state(true)) { }
+
+    private:
+        impl::cancel_ref _ref;
+    };
+}
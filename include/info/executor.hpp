@@ -0,0 +1,260 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <info/_hardware.hpp>
+#include <info/_macros.hpp>
+#include <info/lock.hpp>
+#include <info/queue.hpp>
+
+namespace info {
+    /**
+     * \brief Something that runs tasks.
+     *
+     * Used by info::future to run continuations. Tasks must not throw; if one
+     * does, std::terminate is called.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct executor {
+        using task_type = std::function<void()>;
+
+        virtual void
+        execute(task_type task) = 0;
+
+        virtual ~executor() noexcept = default;
+    };
+
+    /**
+     * \brief An executor running tasks on a fixed number of threads.
+     *
+     * Tasks are handed to the threads through an info::queue, and run in
+     * submission order. On destruction, the tasks still queued are run before
+     * the threads are joined.
+     *
+     * Tasks which block waiting for other tasks of the same pool can deadlock
+     * it, if all threads end up waiting.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct thread_pool final : executor {
+        void
+        execute(task_type task) override {
+            _tasks.push(std::move(task));
+        }
+
+        INFO_NODISCARD_JUST
+        std::size_t
+        size() const noexcept {
+            return _workers.size();
+        }
+
+        explicit thread_pool(std::size_t threads = default_size())
+             : _tasks(),
+               _workers() {
+            _workers.reserve(threads);
+            for (std::size_t i = 0; i < threads; ++i) {
+                _workers.emplace_back([this] { work(); });
+            }
+        }
+
+        thread_pool(const thread_pool& cp) = delete;
+        thread_pool& operator=(const thread_pool& cp) = delete;
+
+        ~thread_pool() noexcept override {
+            _tasks.end();
+            for (auto& w : _workers) w.join();
+        }
+
+        /// The number of threads in a default constructed pool: the number of
+        /// hardware threads, but at least two.
+        static std::size_t
+        default_size() noexcept {
+            return std::max(2U, std::thread::hardware_concurrency());
+        }
+
+    private:
+        void
+        work() noexcept {
+            while (auto task = _tasks.await_pop()) (*task)();
+            // the pool is being destroyed, finish what is left
+            while (auto task = _tasks.try_pop()) (*task)();
+        }
+
+        queue<task_type> _tasks;
+        std::vector<std::thread> _workers;
+    };
+
+    /**
+     * \brief An executor running tasks on a fixed number of threads, each
+     * with its own task deque, which idle threads steal from.
+     *
+     * A task submitted by one of the pool's threads is pushed to that
+     * thread's deque, and the thread runs its newest task first, while its
+     * data is still in cache. Threads which run out of tasks steal the oldest
+     * tasks of the others. Tasks submitted from outside are spread over the
+     * deques in turn. Suits tasks which spawn more tasks, like the nodes of an
+     * info::task_graph; there is no ordering between tasks.
+     *
+     * On destruction, the tasks still queued are run before the threads are
+     * joined.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct work_stealing_pool final : executor {
+        void
+        execute(task_type task) override {
+            const auto& self = current();
+            const auto idx = self.pool == this
+                                    ? self.index
+                                    : _next.fetch_add(1, std::memory_order_relaxed) % _size;
+            {
+                std::scoped_lock lck(_queues[idx].lock);
+                _queues[idx].tasks.push_back(std::move(task));
+            }
+            // pairs with the sleeping count in work()
+            _queued.fetch_add(1, std::memory_order_seq_cst);
+            if (_sleeping.load(std::memory_order_seq_cst) != 0) {
+                std::scoped_lock lck(_mtx);
+                _cv.notify_one();
+            }
+        }
+
+        INFO_NODISCARD_JUST
+        std::size_t
+        size() const noexcept {
+            return _size;
+        }
+
+        explicit work_stealing_pool(std::size_t threads = thread_pool::default_size())
+             : _size(std::max(threads, std::size_t{1})),
+               _queues(std::make_unique<worker_queue[]>(_size)) {
+            _workers.reserve(_size);
+            for (std::size_t i = 0; i < _size; ++i) {
+                _workers.emplace_back([this, i] { work(i); });
+            }
+        }
+
+        work_stealing_pool(const work_stealing_pool& cp) = delete;
+        work_stealing_pool& operator=(const work_stealing_pool& cp) = delete;
+
+        ~work_stealing_pool() noexcept override {
+            {
+                std::scoped_lock lck(_mtx);
+                _stopping = true;
+            }
+            _cv.notify_all();
+            for (auto& w : _workers) w.join();
+        }
+
+    private:
+        struct alignas(impl::cache_line_size) worker_queue {
+            spinlock lock;
+            /// The owner pushes and pops at the back, thieves take from the front.
+            std::deque<task_type> tasks;
+        };
+
+        /// Which pool's thread the calling thread is, if any.
+        struct worker_id {
+            const work_stealing_pool* pool;
+            std::size_t index;
+        };
+
+        static worker_id&
+        current() noexcept {
+            thread_local worker_id id{nullptr, 0};
+            return id;
+        }
+
+        /// Pops the newest task of the own deque, or steals the oldest of another.
+        bool
+        find_task(std::size_t self, task_type& task) {
+            for (std::size_t i = 0; i < _size; ++i) {
+                auto& queue = _queues[(self + i) % _size];
+                std::scoped_lock lck(queue.lock);
+                if (queue.tasks.empty()) continue;
+                if (i == 0) {
+                    task = std::move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                } else {
+                    task = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                }
+                _queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        }
+
+        void
+        work(std::size_t self) noexcept {
+            current() = {this, self};
+            task_type task;
+            for (;;) {
+                if (find_task(self, task)) {
+                    task();
+                    task = nullptr;
+                    continue;
+                }
+
+                std::unique_lock lck(_mtx);
+                _sleeping.fetch_add(1, std::memory_order_seq_cst);
+                _cv.wait(lck, [this] {
+                    return _queued.load(std::memory_order_seq_cst) != 0 || _stopping;
+                });
+                _sleeping.fetch_sub(1, std::memory_order_relaxed);
+                // the pool is being destroyed: leave once everything is done
+                if (_stopping && _queued.load(std::memory_order_relaxed) == 0) break;
+            }
+            current() = {nullptr, 0};
+        }
+
+        const std::size_t _size;
+        std::unique_ptr<worker_queue[]> _queues;
+        std::vector<std::thread> _workers;
+        /// Picks the deque of the next task submitted from outside.
+        std::atomic<std::size_t> _next{0};
+        /// Tasks pushed, but not yet popped.
+        std::atomic<std::size_t> _queued{0};
+        std::atomic<std::size_t> _sleeping{0};
+
+        std::mutex _mtx;
+        std::condition_variable _cv;
+        bool _stopping = false;
+    };
+
+    /**
+     * \brief The process-wide thread_pool used when no executor is specified.
+     */
+    inline executor&
+    default_executor() {
+        static thread_pool pool;
+        return pool;
+    }
+
+    /**
+     * \brief The process-wide work_stealing_pool, used by info::task_graph
+     * when no executor is specified.
+     */
+    inline executor&
+    default_work_stealing_pool() {
+        static work_stealing_pool pool;
+        return pool;
+    }
+}
@@ -33,6 +33,7 @@
 // stdlib
 #include <optional>
 #include <type_traits>
+#include <utility>
 
 // project
 #include "_macros.hpp"
@@ -54,6 +55,9 @@ namespace info {
 
         explicit INFO_UNEXPECTED(const T& value) noexcept
              : value{value} { }
+
+        explicit INFO_UNEXPECTED(T&& value) noexcept
+             : value{std::move(value)} { }
     };
 
     /**
@@ -147,7 +151,15 @@ namespace info {
        * If the computation succeeded the behavior is undefined.
        */
         INFO_NODISCARD("Error accessor returns")
-        E error() const noexcept;
+        E error() const& noexcept;
+
+        /**
+       * \brief Moves the error out of an expected about to die.
+       *
+       * \copydetails error
+       */
+        INFO_NODISCARD("Error accessor returns")
+        E error() && noexcept;
 
         /**
        * \brief Throws the contained exception.
@@ -271,10 +283,16 @@ namespace info {
 
     template<class T, class E>
     E
-    expected<T, E>::error() const noexcept {
+    expected<T, E>::error() const& noexcept {
         return _fail;
     }
 
+    template<class T, class E>
+    E
+    expected<T, E>::error() && noexcept {
+        return std::move(_fail);
+    }
+
     template<class T, class E>
     void
     expected<T, E>::yeet() const {
@@ -288,7 +306,7 @@ namespace info {
         if (INFO_LIKELY_(_ok)) INFO_LIKELY {
                 return std::forward<F>(f)(std::move(_succ));
             }
-        return INFO_UNEXPECTED{std::move(_fail)};
+        return INFO_UNEXPECTED<E>{_fail};
     }
 
     template<class T, class E>
@@ -0,0 +1,680 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+// Asynchronous file reads and writes completing info::futures.
+// Only available on POSIX systems.
+#if __has_include(<unistd.h>) && __has_include(<sys/mman.h>)
+#    define INFO_HAS_FILE_IO 1
+
+#    include <algorithm>
+#    include <cerrno>
+#    include <cstddef>
+#    include <cstdint>
+#    include <cstring>
+#    include <exception>
+#    include <filesystem>
+#    include <memory>
+#    include <string>
+#    include <system_error>
+#    include <thread>
+#    include <type_traits>
+#    include <utility>
+#    include <vector>
+
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+
+#    include <info/_macros.hpp>
+#    include <info/_uring.hpp>
+#    include <info/future.hpp>
+#    include <info/queue.hpp>
+
+namespace info {
+    namespace impl {
+        struct read_request;
+    }
+
+    /**
+     * \brief An owned, contiguous block of bytes read from, or to be written to, a file.
+     *
+     * Either heap allocated, or, for reads through io_service::read_mapped,
+     * a private mapping of the file itself. Move-only.
+     *
+     * A mapped buffer is not a snapshot of the file: until the buffer itself
+     * is written to, writes others make to the file may show through, and
+     * accessing it after the file was truncated below its range raises
+     * SIGBUS. Heap allocated buffers hold a copy, which the file does not
+     * affect.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct io_buffer {
+        using value_type = std::byte;
+        using size_type = std::size_t;
+        using iterator = std::byte*;
+        using const_iterator = const std::byte*;
+
+        INFO_NODISCARD_JUST
+        std::byte*
+        data() noexcept {
+            return _data;
+        }
+
+        INFO_NODISCARD_JUST
+        const std::byte*
+        data() const noexcept {
+            return _data;
+        }
+
+        INFO_NODISCARD_JUST
+        size_type
+        size() const noexcept {
+            return _size;
+        }
+
+        INFO_NODISCARD_JUST
+        bool
+        empty() const noexcept {
+            return _size == 0;
+        }
+
+        /// Whether the buffer is a mapping of the file it was read from,
+        /// which later changes to the file may affect.
+        INFO_NODISCARD_JUST
+        bool
+        mapped() const noexcept {
+            return _map != nullptr;
+        }
+
+        iterator
+        begin() noexcept {
+            return _data;
+        }
+
+        iterator
+        end() noexcept {
+            return _data + _size;
+        }
+
+        const_iterator
+        begin() const noexcept {
+            return _data;
+        }
+
+        const_iterator
+        end() const noexcept {
+            return _data + _size;
+        }
+
+        std::byte&
+        operator[](size_type idx) noexcept {
+            return _data[idx];
+        }
+
+        const std::byte&
+        operator[](size_type idx) const noexcept {
+            return _data[idx];
+        }
+
+        io_buffer() noexcept = default;
+
+        /// An uninitialized buffer of `size` bytes.
+        explicit io_buffer(size_type size)
+             : _data(size != 0 ? new std::byte[size] : nullptr),
+               _size(size) { }
+
+        /// A copy of `size` bytes at `src`.
+        io_buffer(const void* src, size_type size)
+             : io_buffer(size) {
+            if (size != 0) std::memcpy(_data, src, size);
+        }
+
+        io_buffer(const io_buffer& cp) = delete;
+        io_buffer& operator=(const io_buffer& cp) = delete;
+
+        io_buffer(io_buffer&& mv) noexcept
+             : _data(std::exchange(mv._data, nullptr)),
+               _size(std::exchange(mv._size, 0)),
+               _map(std::exchange(mv._map, nullptr)),
+               _map_size(std::exchange(mv._map_size, 0)) { }
+        io_buffer&
+        operator=(io_buffer&& mv) noexcept {
+            io_buffer(std::move(mv)).swap(*this);
+            return *this;
+        }
+
+        void
+        swap(io_buffer& other) noexcept {
+            std::swap(_data, other._data);
+            std::swap(_size, other._size);
+            std::swap(_map, other._map);
+            std::swap(_map_size, other._map_size);
+        }
+
+        ~io_buffer() noexcept {
+            if (_map) {
+                ::munmap(_map, _map_size);
+            } else {
+                delete[] _data;
+            }
+        }
+
+    private:
+        friend struct io_service;
+        friend struct impl::read_request;
+
+        /// Takes over a mapping of `map_size` bytes, of which the buffer is
+        /// the `size` bytes starting at `skip`.
+        static io_buffer
+        adopt_mapping(void* map, size_type map_size, size_type skip, size_type size) noexcept {
+            io_buffer buf;
+            buf._map = map;
+            buf._map_size = map_size;
+            buf._data = static_cast<std::byte*>(map) + skip;
+            buf._size = size;
+            return buf;
+        }
+
+        /// Forgets the bytes past `size`, after a short read.
+        void
+        truncate(size_type size) noexcept {
+            _size = std::min(_size, size);
+        }
+
+        std::byte* _data = nullptr;
+        size_type _size = 0;
+        void* _map = nullptr;
+        size_type _map_size = 0;
+    };
+
+    namespace impl {
+        /// A read or write queued to an io_service.
+        struct io_request {
+            /// Completes the future of the request with what was transferred.
+            virtual void
+            finish() noexcept = 0;
+
+            virtual void
+            fail(const std::exception_ptr& exc) noexcept = 0;
+
+            void
+            fail_errno(int err, const char* what) noexcept {
+                fail(std::make_exception_ptr(std::system_error(err, std::system_category(), what)));
+            }
+
+            INFO_NODISCARD_JUST
+            std::size_t
+            left() const noexcept {
+                return len - done;
+            }
+
+            io_request(bool write, int fd, std::filesystem::path path, std::uint64_t offset) noexcept
+                 : write(write),
+                   fd(fd),
+                   path(std::move(path)),
+                   offset(offset) { }
+
+            io_request(const io_request& cp) = delete;
+            io_request& operator=(const io_request& cp) = delete;
+
+            /// Closes the descriptor if the request opened it.
+            virtual ~io_request() noexcept {
+                if (!path.empty() && fd >= 0) ::close(fd);
+            }
+
+            const bool write;
+            int fd;
+            /// Empty if the caller provided the descriptor.
+            const std::filesystem::path path;
+            const std::uint64_t offset;
+            std::byte* data = nullptr;
+            std::size_t len = 0;
+            /// Bytes transferred so far.
+            std::size_t done = 0;
+        };
+
+        struct read_request final : io_request {
+            void
+            finish() noexcept override {
+                buf.truncate(done);
+                result.set_value(std::move(buf));
+            }
+
+            void
+            fail(const std::exception_ptr& exc) noexcept override {
+                result.set_exception(exc);
+            }
+
+            read_request(int fd, std::filesystem::path path, std::uint64_t offset, std::size_t length, bool may_map) noexcept
+                 : io_request(false, fd, std::move(path), offset),
+                   may_map(may_map) {
+                len = length;
+            }
+
+            /// Whether the read may be served by mapping the file.
+            const bool may_map;
+            io_buffer buf;
+            promise<io_buffer> result;
+        };
+
+        struct write_request final : io_request {
+            void
+            finish() noexcept override {
+                result.set_value(done);
+            }
+
+            void
+            fail(const std::exception_ptr& exc) noexcept override {
+                result.set_exception(exc);
+            }
+
+            write_request(int fd, std::filesystem::path path, std::uint64_t offset, io_buffer buffer) noexcept
+                 : io_request(true, fd, std::move(path), offset),
+                   buf(std::move(buffer)) {
+                data = buf.data();
+                len = buf.size();
+            }
+
+            io_buffer buf;
+            promise<std::size_t> result;
+        };
+    }
+
+    /**
+     * \brief A dedicated pool of threads serving file reads and writes.
+     *
+     * Each request returns a future completed once the data was transferred.
+     * Workers take requests in batches: every batch gets readahead hints
+     * (`posix_fadvise(WILLNEED)`) for its reads, and is ordered by file and
+     * offset. Then, if the kernel supports io_uring, the whole batch is
+     * submitted to the worker's ring in a single system call, and completes
+     * in parallel; otherwise, it is served with `pread`/`pwrite`. Reads made
+     * with read_mapped, of at least `mmap_threshold` bytes from regular
+     * files, are served by mapping the file instead of copying it; see
+     * io_buffer for what that entails.
+     *
+     * Descriptors given to the service must stay open until their request
+     * completes. Requests made by path open and close the file themselves.
+     * Reads past the end of the file return a shorter buffer; writes either
+     * write everything or fail.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct io_service {
+        /// Reads through read_mapped at least this long are served by mapping the file.
+        constexpr const static std::size_t mmap_threshold = std::size_t{1} << 20;
+        /// The most requests a worker serves at once.
+        constexpr const static unsigned max_batch = 32;
+
+        /// Reads at most `len` bytes of `fd`, from `offset`.
+        future<io_buffer>
+        read(int fd, std::uint64_t offset, std::size_t len) {
+            return submit<impl::read_request>(fd, std::filesystem::path(), offset, len, false);
+        }
+
+        /// Reads at most `len` bytes of the file at `path`, from `offset`.
+        future<io_buffer>
+        read(const std::filesystem::path& path, std::uint64_t offset, std::size_t len) {
+            return submit<impl::read_request>(-1, path, offset, len, false);
+        }
+
+        /// Like read, but if at least `mmap_threshold` bytes are read from a
+        /// regular file, the buffer maps the file instead of copying it.
+        /// The mapping is not a snapshot of the file: see io_buffer.
+        future<io_buffer>
+        read_mapped(int fd, std::uint64_t offset, std::size_t len) {
+            return submit<impl::read_request>(fd, std::filesystem::path(), offset, len, true);
+        }
+
+        /// Like read, but may map the file. See read_mapped(int, std::uint64_t, std::size_t).
+        future<io_buffer>
+        read_mapped(const std::filesystem::path& path, std::uint64_t offset, std::size_t len) {
+            return submit<impl::read_request>(-1, path, offset, len, true);
+        }
+
+        /// Writes `data` to `fd`, from `offset`. The future receives the number of bytes written.
+        future<std::size_t>
+        write(int fd, std::uint64_t offset, io_buffer data) {
+            return submit<impl::write_request>(fd, std::filesystem::path(), offset, std::move(data));
+        }
+
+        /// Writes `data` to the file at `path`, from `offset`, creating it if
+        /// it does not exist. The future receives the number of bytes written.
+        future<std::size_t>
+        write(const std::filesystem::path& path, std::uint64_t offset, io_buffer data) {
+            return submit<impl::write_request>(-1, path, offset, std::move(data));
+        }
+
+        /// Whether requests are served through io_uring.
+        INFO_NODISCARD_JUST
+        bool
+        uses_io_uring() const noexcept {
+#    ifdef INFO_HAS_URING_
+            return !_rings.empty();
+#    else
+            return false;
+#    endif
+        }
+
+        INFO_NODISCARD_JUST
+        std::size_t
+        size() const noexcept {
+            return _workers.size();
+        }
+
+        /**
+         * \brief Starts `threads` workers.
+         *
+         * If `use_io_uring` is true, and the kernel supports it, every worker
+         * gets its own io_uring instance.
+         */
+        explicit io_service(std::size_t threads = default_size(), bool use_io_uring = true)
+             : _requests(),
+               _workers() {
+#    ifdef INFO_HAS_URING_
+            if (use_io_uring) {
+                for (std::size_t i = 0; i < threads; ++i) {
+                    auto ring = std::make_unique<impl::uring>();
+                    if (!ring->init(max_batch)) {
+                        _rings.clear();
+                        break;
+                    }
+                    _rings.push_back(std::move(ring));
+                }
+            }
+#    else
+            static_cast<void>(use_io_uring);
+#    endif
+
+            _workers.reserve(threads);
+            for (std::size_t i = 0; i < threads; ++i) {
+                _workers.emplace_back([this, i] { work(i); });
+            }
+        }
+
+        io_service(const io_service& cp) = delete;
+        io_service& operator=(const io_service& cp) = delete;
+
+        /// Serves the requests still queued, then joins the workers.
+        ~io_service() noexcept {
+            _requests.end();
+            for (auto& w : _workers) w.join();
+        }
+
+        /// The number of workers of a default constructed service. I/O bound
+        /// threads mostly wait, so this does not depend on the number of cores.
+        static std::size_t
+        default_size() noexcept {
+            return 4;
+        }
+
+    private:
+        using request_ptr = std::unique_ptr<impl::io_request>;
+
+        template<class Request, class... Args>
+        decltype(std::declval<Request&>().result.get_future())
+        submit(int fd, const std::filesystem::path& path, std::uint64_t offset, Args&&... args) {
+            auto req = std::make_unique<Request>(fd, path, offset, std::forward<Args>(args)...);
+            auto ftr = req->result.get_future();
+            _requests.push(std::move(req));
+            return ftr;
+        }
+
+        void
+        work(std::size_t idx) noexcept {
+#    ifdef INFO_HAS_URING_
+            auto ring = idx < _rings.size() ? _rings[idx].get() : nullptr;
+#    else
+            static_cast<void>(idx);
+            void* ring = nullptr;
+#    endif
+            std::vector<request_ptr> batch;
+            batch.reserve(max_batch);
+            while (auto req = _requests.await_pop()) {
+                batch.push_back(std::move(*req));
+                while (batch.size() < max_batch) {
+                    auto next = _requests.try_pop();
+                    if (!next) break;
+                    batch.push_back(std::move(*next));
+                }
+                serve(batch, ring);
+                batch.clear();
+            }
+            // the service is being destroyed, finish what is left
+            while (auto req = _requests.try_pop()) {
+                batch.push_back(std::move(*req));
+                serve(batch, ring);
+                batch.clear();
+            }
+        }
+
+        template<class Ring>
+        static void
+        serve(std::vector<request_ptr>& batch, Ring* ring) noexcept {
+            auto end = std::remove_if(batch.begin(), batch.end(), [](request_ptr& req) {
+                return !prepare(*req);
+            });
+            batch.erase(end, batch.end());
+            std::sort(batch.begin(), batch.end(), [](const request_ptr& lhs, const request_ptr& rhs) {
+                return std::make_pair(lhs->fd, lhs->offset) < std::make_pair(rhs->fd, rhs->offset);
+            });
+
+#    ifdef INFO_HAS_URING_
+            if constexpr (std::is_same_v<Ring, impl::uring>) {
+                if (ring) {
+                    serve_ring(batch, *ring);
+                    return;
+                }
+            }
+#    else
+            static_cast<void>(ring);
+#    endif
+            for (auto& req : batch) transfer(*req);
+        }
+
+        /// Opens the file, and sets up the buffer of reads. Serves large
+        /// reads by mapping. Returns whether the request still needs to be
+        /// transferred; if not, it is already completed.
+        static bool
+        prepare(impl::io_request& req) noexcept {
+            if (!req.path.empty()) {
+                const auto flags = req.write ? O_WRONLY | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC;
+                req.fd = ::open(req.path.c_str(), flags, 0666);
+                if (req.fd < 0) {
+                    req.fail_errno(errno, "open");
+                    return false;
+                }
+            }
+            if (req.write) return true;
+
+            auto& read = static_cast<impl::read_request&>(req);
+            struct stat st{};
+            if (::fstat(read.fd, &st) == 0 && S_ISREG(st.st_mode)) {
+                const auto file_size = static_cast<std::uint64_t>(st.st_size);
+                const auto available = read.offset < file_size ? file_size - read.offset : 0;
+                read.len = static_cast<std::size_t>(std::min<std::uint64_t>(read.len, available));
+                if (read.may_map && read.len >= mmap_threshold && map(read)) return false;
+            }
+            ::posix_fadvise(read.fd, static_cast<off_t>(read.offset), static_cast<off_t>(read.len), POSIX_FADV_WILLNEED);
+
+            try {
+                read.buf = io_buffer(read.len);
+            } catch (...) {
+                read.fail(std::current_exception());
+                return false;
+            }
+            read.data = read.buf.data();
+            if (read.len == 0) {
+                read.finish();
+                return false;
+            }
+            return true;
+        }
+
+        /// Serves a read by mapping the file. The pages are read in by
+        /// mmap, on the worker.
+        static bool
+        map(impl::read_request& read) noexcept {
+            const auto page = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+            const auto start = read.offset / page * page;
+            const auto skip = static_cast<std::size_t>(read.offset - start);
+            const auto map_size = read.len + skip;
+
+            const auto ptr = ::mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, read.fd, static_cast<off_t>(start));
+            if (ptr == MAP_FAILED) return false;
+            ::madvise(ptr, map_size, MADV_SEQUENTIAL);
+
+            read.buf = io_buffer::adopt_mapping(ptr, map_size, skip, read.len);
+            read.done = read.len;
+            read.finish();
+            return true;
+        }
+
+        /// Transfers the rest of the request with pread/pwrite, and completes it.
+        static void
+        transfer(impl::io_request& req) noexcept {
+            while (req.left() != 0) {
+                const auto pos = static_cast<off_t>(req.offset + req.done);
+                const auto n = req.write ? ::pwrite(req.fd, req.data + req.done, req.left(), pos)
+                                         : ::pread(req.fd, req.data + req.done, req.left(), pos);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    req.fail_errno(errno, req.write ? "pwrite" : "pread");
+                    return;
+                }
+                if (n == 0) {
+                    // end of file; a write which makes no progress would never complete
+                    if (req.write) {
+                        req.fail_errno(EIO, "pwrite");
+                        return;
+                    }
+                    break;
+                }
+                req.done += static_cast<std::size_t>(n);
+            }
+            req.finish();
+        }
+
+#    ifdef INFO_HAS_URING_
+        /// Submits the batch to the ring at once, and waits for all of it.
+        static void
+        serve_ring(std::vector<request_ptr>& batch, impl::uring& ring) noexcept {
+            unsigned inflight = 0;
+            const auto queue = [&](impl::io_request& req) {
+                auto sqe = ring.get_sqe(); // never full: at most max_batch are in flight
+                sqe->opcode = req.write ? IORING_OP_WRITE : IORING_OP_READ;
+                sqe->fd = req.fd;
+                sqe->addr = reinterpret_cast<std::uint64_t>(req.data + req.done);
+                sqe->len = static_cast<std::uint32_t>(std::min<std::size_t>(req.left(), 1U << 30));
+                sqe->off = req.offset + req.done;
+                sqe->user_data = reinterpret_cast<std::uint64_t>(&req);
+                ++inflight;
+            };
+
+            for (auto& req : batch) queue(*req);
+            while (inflight != 0) {
+                const auto ret = ring.submit(1);
+                if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY) {
+                    // the ring is unusable: only possible through a bug
+                    std::terminate();
+                }
+                ring.reap([&](const io_uring_cqe& cqe) {
+                    --inflight;
+                    auto& req = *reinterpret_cast<impl::io_request*>(cqe.user_data);
+                    if (cqe.res < 0) {
+                        const auto err = -cqe.res;
+                        if (err == EINTR || err == EAGAIN) {
+                            queue(req);
+                        } else if (err == EINVAL || err == EOPNOTSUPP) {
+                            // the kernel has io_uring, but not this operation
+                            transfer(req);
+                        } else {
+                            req.fail_errno(err, req.write ? "io_uring write" : "io_uring read");
+                        }
+                    } else if (cqe.res == 0 && req.write) {
+                        req.fail_errno(EIO, "io_uring write");
+                    } else if (cqe.res == 0 || (req.done += static_cast<std::size_t>(cqe.res)) == req.len) {
+                        req.finish();
+                    } else {
+                        queue(req); // short transfer, go on with the rest
+                    }
+                });
+            }
+        }
+#    endif
+
+        queue<request_ptr> _requests;
+#    ifdef INFO_HAS_URING_
+        /// One per worker, or none if io_uring is not used.
+        std::vector<std::unique_ptr<impl::uring>> _rings;
+#    endif
+        std::vector<std::thread> _workers;
+    };
+
+    /**
+     * \brief The process-wide io_service used by info::async_read and info::async_write.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    inline io_service&
+    default_io_service() {
+        static io_service service;
+        return service;
+    }
+
+    /**
+     * \brief Reads at most `len` bytes of `fd` from `offset`, on the default io_service.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    inline future<io_buffer>
+    async_read(int fd, std::uint64_t offset, std::size_t len) {
+        return default_io_service().read(fd, offset, len);
+    }
+
+    /**
+     * \brief Reads at most `len` bytes of the file at `path` from `offset`,
+     * on the default io_service.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    inline future<io_buffer>
+    async_read(const std::filesystem::path& path, std::uint64_t offset, std::size_t len) {
+        return default_io_service().read(path, offset, len);
+    }
+
+    /**
+     * \brief Writes `data` to `fd` from `offset`, on the default io_service.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    inline future<std::size_t>
+    async_write(int fd, std::uint64_t offset, io_buffer data) {
+        return default_io_service().write(fd, offset, std::move(data));
+    }
+
+    /**
+     * \brief Writes `data` to the file at `path` from `offset`, on the
+     * default io_service.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    inline future<std::size_t>
+    async_write(const std::filesystem::path& path, std::uint64_t offset, io_buffer data) {
+        return default_io_service().write(path, offset, std::move(data));
+    }
+}
+
+#endif
@@ -27,316 +27,760 @@
 // CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
 // OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
 
 #include <info/_macros.hpp>
+#include <info/_parking.hpp>
+#include <info/_state_pool.hpp>
+#include <info/cancellation.hpp>
+#include <info/executor.hpp>
 #include <info/expected.hpp>
 #include <info/fail.hpp>
+#include <info/future_trace.hpp>
 #include <info/static_warning.hpp>
 
+#include <atomic>
 #include <cassert>
-#include <condition_variable>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <future>
-#include <mutex>
-#include <thread>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace info {
+    /**
+     * \brief Tag type selecting inline execution for future continuations.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct run_inline_t {
+        explicit run_inline_t() = default;
+    };
+    /**
+     * \brief Passed to `then` to run the continuation in the thread which
+     * completes the previous future, or right away if it is already complete.
+     *
+     * Only for cheap continuations: they delay whoever completes the future,
+     * usually the thread calling `promise::set_value`.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    inline constexpr run_inline_t run_inline{};
+
     namespace impl {
-        enum class state_status {
+        enum class state_status : std::uint32_t {
             InProgress,
             Completed,
-            Errored
+            Errored,
+            /// Completed with an error value, instead of an exception.
+            /// Only used by the states of info::result_future.
+            Failed
         };
 
-        struct awaitable {
-            template<class Fn>
-            void
-            wait(Fn&& fn) {
-                std::unique_lock<std::mutex> lck(_mtx);
-                _cv.wait(lck, std::forward<Fn>(fn));
+        /// Intrusive reference to a shared state.
+        template<class S>
+        struct state_ptr {
+            S*
+            get() const noexcept {
+                return _ptr;
+            }
+
+            S*
+            operator->() const noexcept {
+                return _ptr;
+            }
+
+            S&
+            operator*() const noexcept {
+                return *_ptr;
+            }
+
+            explicit operator bool() const noexcept {
+                return _ptr != nullptr;
             }
 
-            template<class Rep, class Period, class Fn>
             bool
-            wait_for(const std::chrono::duration<Rep, Period>& dur, Fn&& fn) {
-                std::unique_lock<std::mutex> lck(_mtx);
-                return _cv.wait_for(lck, dur, std::forward<Fn>(fn));
+            operator==(std::nullptr_t) const noexcept {
+                return _ptr == nullptr;
             }
 
-            template<class Clock, class Duration, class Fn>
             bool
-            wait_until(const std::chrono::time_point<Clock, Duration>& tp, Fn&& fn) {
-                std::unique_lock<std::mutex> lck(_mtx);
-                return _cv.wait_until(lck, tp, std::forward<Fn>(fn));
+            operator!=(std::nullptr_t) const noexcept {
+                return _ptr != nullptr;
+            }
+
+            void
+            reset() noexcept {
+                if (auto p = std::exchange(_ptr, nullptr)) p->release();
+            }
+
+            /// Gives up ownership of the reference without releasing it.
+            S*
+            detach() noexcept {
+                return std::exchange(_ptr, nullptr);
+            }
+
+            /// Takes ownership of a reference already accounted for.
+            static state_ptr
+            adopt(S* ptr) noexcept {
+                state_ptr ret;
+                ret._ptr = ptr;
+                return ret;
+            }
+
+            template<class... Args>
+            static state_ptr
+            make(Args&&... args) {
+                return state_ptr(new S(std::forward<Args>(args)...));
+            }
+
+            state_ptr() noexcept
+                 : _ptr(nullptr) { }
+            state_ptr(std::nullptr_t) noexcept
+                 : _ptr(nullptr) { }
+            explicit state_ptr(S* ptr) noexcept
+                 : _ptr(ptr) {
+                if (_ptr) _ptr->add_ref();
+            }
+
+            state_ptr(const state_ptr& cp) noexcept
+                 : state_ptr(cp._ptr) { }
+
+            /// Upcasts a reference to a derived state.
+            template<class U, class = std::enable_if_t<std::is_convertible_v<U*, S*>>>
+            state_ptr(state_ptr<U>&& mv) noexcept
+                 : _ptr(mv.detach()) { }
+            state_ptr&
+            operator=(const state_ptr& cp) noexcept {
+                state_ptr(cp).swap(*this);
+                return *this;
+            }
+
+            state_ptr(state_ptr&& mv) noexcept
+                 : _ptr(std::exchange(mv._ptr, nullptr)) { }
+            state_ptr&
+            operator=(state_ptr&& mv) noexcept {
+                state_ptr(std::move(mv)).swap(*this);
+                return *this;
+            }
+
+            void
+            swap(state_ptr& other) noexcept {
+                std::swap(_ptr, other._ptr);
             }
 
-            std::condition_variable _cv;
+            ~state_ptr() noexcept {
+                reset();
+            }
 
         private:
-            std::mutex _mtx;
+            S* _ptr;
         };
 
-        template<class S, class T>
-        struct chained_state;
+        /// Something to run once a shared state completes. Intrusive, so
+        /// attaching a continuation to a state does not allocate.
+        struct continuation {
+            /// Called exactly once, after the state the continuation is attached to completed.
+            virtual void
+            on_ready() noexcept = 0;
 
-        template<class T>
-        struct future_state : private awaitable {
-            using value_type = T;
-            static_warning(std::is_nothrow_destructible_v<value_type>,
-                           "future_state<T>: T has a throwing destructor. "
-                           "This may lead to unexpected termination.");
+        protected:
+            virtual ~continuation() noexcept = default;
 
-            template<class... Args>
+        private:
+            friend struct state_base;
+
+            /// The next continuation attached to the same state.
+            continuation* _next = nullptr;
+        };
+
+        /// The type-independent part of every shared state: reference count,
+        /// status, waiting, and the continuations to run on completion.
+        ///
+        /// Lock-free: the status is a single atomic word, checked with one
+        /// load, and blocking waiters park on it directly. Continuations are
+        /// attached to an atomic stack, which completion closes.
+        struct state_base {
             void
-            put_value(Args&&... args) {
-                new (&_value) value_type(std::forward<Args>(args)...);
-                _status = state_status::Completed;
-                _cv.notify_one();
+            add_ref() noexcept {
+                _refs.fetch_add(1, std::memory_order_relaxed);
             }
+
             void
-            put_exception(const std::exception_ptr& ex) {
-                new (&_exc) std::exception_ptr(ex);
-                _status = state_status::Errored;
-                _cv.notify_one();
+            release() noexcept {
+                if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+            }
+
+            INFO_NODISCARD_JUST
+            bool
+            is_ready() const noexcept {
+                return (_status.load(std::memory_order_acquire) & status_mask) != in_progress;
             }
 
             void
-            wait() {
-                awaitable::wait([this] { return _status != state_status::InProgress; });
+            wait() noexcept {
+                auto word = _status.load(std::memory_order_acquire);
+                while ((word & status_mask) == in_progress) {
+                    if (!announce_waiter(word)) continue;
+                    park(_status, word);
+                    word = _status.load(std::memory_order_acquire);
+                }
             }
 
             template<class Rep, class Period>
             bool
-            wait_for(const std::chrono::duration<Rep, Period>& dur) {
-                return awaitable::wait_for(dur, [this] { return _status != state_status::InProgress; });
+            wait_for(const std::chrono::duration<Rep, Period>& dur) noexcept {
+                return wait_until(parking_clock::now() + dur);
             }
 
             template<class Clock, class Duration>
             bool
-            wait_until(const std::chrono::time_point<Clock, Duration>& tp) {
-                return awaitable::wait_until(tp, [this] { return _status != state_status::InProgress; });
+            wait_until(const std::chrono::time_point<Clock, Duration>& tp) noexcept {
+                auto word = _status.load(std::memory_order_acquire);
+                while ((word & status_mask) == in_progress) {
+                    const auto now = Clock::now();
+                    if (now >= tp) return false;
+                    if (!announce_waiter(word)) continue;
+
+                    const auto left = std::chrono::duration_cast<parking_clock::duration>(tp - now);
+                    park_until(_status, word, parking_clock::now() + left);
+                    word = _status.load(std::memory_order_acquire);
+                }
+                return true;
+            }
+
+            /// Runs the continuation once the state completes: in the completing
+            /// thread, or, if it is already complete, right now.
+            /// Continuations run in the order they were attached.
+            void
+            attach(continuation& cont) {
+                if (!try_attach(cont)) cont.on_ready();
+            }
+
+            /// Like attach, but if the state is already complete, returns false
+            /// instead of running the continuation.
+            bool
+            try_attach(continuation& cont) noexcept {
+                auto head = _continuations.load(std::memory_order_acquire);
+                do {
+                    if (head == closed_list()) return false;
+                    cont._next = head;
+                } while (!_continuations.compare_exchange_weak(head,
+                                                               &cont,
+                                                               std::memory_order_release,
+                                                               std::memory_order_acquire));
+                return true;
+            }
+
+            /// The token telling whether the result of this state is still wanted.
+            /// Only states given a token store one; the rest are never cancelled.
+            INFO_NODISCARD_JUST
+            const cancellation_token&
+            token() const noexcept {
+                const auto offset = _status.load(std::memory_order_relaxed) >> token_shift;
+                if (offset == 0) {
+                    static const cancellation_token none;
+                    return none;
+                }
+                return *reinterpret_cast<const cancellation_token*>(reinterpret_cast<const char*>(this) + offset);
+            }
+
+            /// Called when the consumer of the state drops it unconsumed.
+            void
+            abandon() const noexcept {
+                if (!is_ready()) token().abandon();
+            }
+
+#ifdef INFO_TRACE_FUTURES
+            /// Identifies the state in traces. Never shared with another
+            /// state, unlike its address.
+            INFO_NODISCARD_JUST
+            std::uint64_t
+            trace_id() const noexcept {
+                return _trace_id;
+            }
+#endif
+
+            state_base() noexcept
+                 : _refs(0),
+                   _status(in_progress),
+                   _continuations(nullptr) {
+                INFO_TRACE_FUTURE_(created, this);
+            }
+
+            state_base(const state_base& cp) = delete;
+            state_base& operator=(const state_base& cp) = delete;
+
+            virtual ~state_base() noexcept = default;
+
+            /// Every state is allocated from the per-thread state caches.
+            /// The destructor is virtual, so freeing through a state_base
+            /// works for every state type.
+            static void*
+            operator new(std::size_t size) {
+                return allocate_state(size);
+            }
+
+            static void
+            operator delete(void* ptr) noexcept {
+                deallocate_state(ptr);
+            }
+
+            /// Over-aligned states are left to the global allocator.
+            static void*
+            operator new(std::size_t size, std::align_val_t align) {
+                return ::operator new(size, align);
+            }
+
+            static void
+            operator delete(void* ptr, std::align_val_t align) noexcept {
+                ::operator delete(ptr, align);
+            }
+
+        protected:
+            /// Makes token() return `token`, a member of the derived state.
+            /// Called by the constructors of states storing a token.
+            void
+            set_token(const cancellation_token& token) noexcept {
+                const auto offset = reinterpret_cast<const char*>(&token) - reinterpret_cast<const char*>(this);
+                assert(offset > 0 && static_cast<std::uint64_t>(offset) < (std::uint64_t{1} << (32 - token_shift)));
+                _status.fetch_or(static_cast<std::uint32_t>(offset) << token_shift, std::memory_order_relaxed);
+            }
+
+            void
+            complete(state_status status) noexcept {
+                INFO_TRACE_FUTURE_(ready, this);
+                // the status is in progress, all zeroes, so or-ing keeps the token's offset
+                const auto prev = _status.fetch_or(static_cast<std::uint32_t>(status),
+                                                   std::memory_order_acq_rel);
+                if (prev & waiters_bit) unpark_all(_status);
+
+                auto conts = _continuations.exchange(closed_list(), std::memory_order_acq_rel);
+                // attached as a stack, reverse to run them in attachment order
+                continuation* ordered = nullptr;
+                while (conts) {
+                    auto next = conts->_next;
+                    conts->_next = ordered;
+                    ordered = conts;
+                    conts = next;
+                }
+                while (ordered) {
+                    // on_ready may destroy the continuation
+                    auto next = ordered->_next;
+                    ordered->on_ready();
+                    ordered = next;
+                }
+            }
+
+            /// Only to be read after the state was observed to be complete.
+            state_status
+            completed_status() const noexcept {
+                return static_cast<state_status>(_status.load(std::memory_order_acquire) & status_mask);
+            }
+
+        private:
+            constexpr const static std::uint32_t in_progress = static_cast<std::uint32_t>(state_status::InProgress);
+            constexpr const static std::uint32_t status_mask = 0b011;
+            /// Set while threads may be parked on the status word.
+            constexpr const static std::uint32_t waiters_bit = 0b100;
+            /// The rest of the status word is the offset of the state's token
+            /// from the state, or zero if it stores none. Keeps the token out
+            /// of states which have none, without a virtual call to find it.
+            constexpr const static std::uint32_t token_shift = 3;
+
+            /// Sets the waiters bit in `word` and the status, unless it is
+            /// already set. Returns false, with `word` reloaded, if the status
+            /// changed meanwhile.
+            bool
+            announce_waiter(std::uint32_t& word) noexcept {
+                if (word & waiters_bit) return true;
+                if (!_status.compare_exchange_weak(word, word | waiters_bit, std::memory_order_acquire)) return false;
+                word |= waiters_bit;
+                return true;
+            }
+
+            /// Marks the continuation stack of a completed state. Never dereferenced.
+            static continuation*
+            closed_list() noexcept {
+                return reinterpret_cast<continuation*>(std::uintptr_t{1});
+            }
+
+            std::atomic<unsigned> _refs;
+            std::atomic<std::uint32_t> _status;
+            /// The continuations attached, most recent first, or closed_list().
+            std::atomic<continuation*> _continuations;
+#ifdef INFO_TRACE_FUTURES
+            const std::uint64_t _trace_id = next_trace_id();
+#endif
+        };
+
+        /// A state of type S observing a cancellation token, for promises
+        /// created with one.
+        template<class S>
+        struct cancellable_state final : S {
+            explicit cancellable_state(cancellation_token token) noexcept
+                 : S(),
+                   _token(std::move(token)) {
+                this->set_token(_token);
+            }
+
+        private:
+            /// Set at construction, never changed.
+            cancellation_token _token;
+        };
+
+        template<class T>
+        struct future_state : state_base {
+            using value_type = T;
+            static_warning(std::is_nothrow_destructible_v<value_type>,
+                           "future_state<T>: T has a throwing destructor. "
+                           "This may lead to unexpected termination.");
+
+            template<class... Args>
+            void
+            put_value(Args&&... args) {
+                new (&_value) value_type(std::forward<Args>(args)...);
+                complete(state_status::Completed);
+            }
+            void
+            put_exception(const std::exception_ptr& ex) {
+                new (&_exc) std::exception_ptr(ex);
+                complete(state_status::Errored);
             }
 
             value_type
             get() {
                 wait();
                 // clang-format off
-                if (INFO_UNLIKELY_(_status == state_status::Errored)) INFO_UNLIKELY {
+                if (INFO_UNLIKELY_(completed_status() == state_status::Errored)) INFO_UNLIKELY {
                     std::rethrow_exception(_exc);
                 }
                 // clang-format on
                 return _value;
             }
 
+            /// Like get(), but moves the value out of the state.
+            value_type
+            take() {
+                wait();
+                // clang-format off
+                if (INFO_UNLIKELY_(completed_status() == state_status::Errored)) INFO_UNLIKELY {
+                    std::rethrow_exception(_exc);
+                }
+                // clang-format on
+                return std::move(_value);
+            }
+
             expected<value_type, std::exception_ptr>
             expect() {
                 wait();
                 // clang-format off
-                if (INFO_UNLIKELY_(_status == state_status::Errored)) INFO_UNLIKELY {
+                if (INFO_UNLIKELY_(completed_status() == state_status::Errored)) INFO_UNLIKELY {
                     return info::INFO_UNEXPECTED{_exc};
                 }
                 // clang-format on
                 return _value;
             }
 
-            future_state()
-                 : awaitable(),
-                   _status(state_status::InProgress) { }
-
-            future_state(const future_state& cp) = delete;
-            future_state& operator=(const future_state& cp) = delete;
+            future_state() noexcept
+                 : state_base() { }
 
-            future_state(future_state&& mv) noexcept(
-                   std::is_nothrow_move_constructible_v<value_type>)
-                 : awaitable(),
-                   _status(mv._status) {
-                switch (_status) {
+            ~future_state() noexcept override {
+                switch (completed_status()) {
                 case state_status::InProgress:
+                case state_status::Failed:
                     return;
                 case state_status::Completed:
-                    new (&_value) value_type(std::move(mv._value));
+                    _value.~value_type();
                     return;
                 case state_status::Errored:
-                    new (&_exc) std::exception_ptr(std::move(mv._exc));
+                    _exc.~exception_ptr();
                     return;
                 }
                 INFO_UNREACHABLE;
             }
-            future_state&
-            operator=(future_state&& mv) noexcept(
-                   std::is_nothrow_move_constructible_v<value_type>) {
-                _status = mv._status;
-                switch (_status) {
-                case state_status::InProgress:
-                    break;
-                case state_status::Completed:
-                    new (&_value) value_type(std::move(mv._value));
-                    break;
-                case state_status::Errored:
-                    new (&_exc) std::exception_ptr(std::move(mv._exc));
-                    break;
-                }
-                return *this;
+
+            /// Whether the state completed with an exception. Only to be called
+            /// once the state is complete, like the accessors below.
+            INFO_NODISCARD_JUST
+            bool
+            has_exception() const noexcept {
+                return completed_status() == state_status::Errored;
             }
 
-            ~future_state() noexcept {
-                switch (_status) {
-                case state_status::InProgress:
-                    return;
-                case state_status::Completed:
-                    _value.~value_type();
-                    return;
-                case state_status::Errored:
-                    _exc.~exception_ptr();
-                    return;
-                }
-                INFO_UNREACHABLE;
+            INFO_NODISCARD_JUST
+            const value_type&
+            value() const noexcept {
+                assert(completed_status() == state_status::Completed);
+                return _value;
             }
 
-        private:
-            template<class S, class V>
-            friend struct chained_state;
+            /// For the only consumer of the state, to move the value on.
+            INFO_NODISCARD_JUST
+            value_type&&
+            take_value() noexcept {
+                assert(completed_status() == state_status::Completed);
+                return std::move(_value);
+            }
 
+            INFO_NODISCARD_JUST
+            const std::exception_ptr&
+            exception() const noexcept {
+                assert(completed_status() == state_status::Errored);
+                return _exc;
+            }
+
+        private:
             union {
                 value_type _value;
                 std::exception_ptr _exc;
             };
-            state_status _status;
         };
 
-        template<class S, class T>
-        struct chained_state : private awaitable {
-            using value_type = T;
-            using owned_type = S;
-            using prev_type = typename owned_type::value_type;
+        template<class S>
+        struct future;
 
-            void
-            wait() {
-                awaitable::wait([this] { return _status != state_status::InProgress; });
-            }
+        /// Moves the state out of a future. Defined below future, for the
+        /// states declared above it.
+        template<class S>
+        state_ptr<S>
+        release_state(future<S>& ftr) noexcept;
 
-            template<class Rep, class Period>
-            bool
-            wait_for(const std::chrono::duration<Rep, Period>& dur) {
-                return awaitable::wait_for(dur, [this] { return _status != state_status::InProgress; });
-            }
+        /// The value a continuation returning R produces: if R is a future,
+        /// its value, otherwise R itself.
+        template<class R>
+        struct unwrapped {
+            using type = R;
+        };
+        template<class S>
+        struct unwrapped<future<S>> {
+            using type = typename S::value_type;
+        };
+        template<class R>
+        using unwrapped_t = typename unwrapped<R>::type;
 
-            template<class Clock, class Duration>
-            bool
-            wait_until(const std::chrono::time_point<Clock, Duration>& tp) {
-                return awaitable::wait_until(tp, [this] { return _status != state_status::InProgress; });
+        /// Completes a state with the result of another, once that completes.
+        template<class T>
+        struct state_forwarder final : continuation {
+            /// Attaches to `inner`. Until it completes, `outer` is kept alive.
+            void
+            forward(state_ptr<future_state<T>> inner, future_state<T>& outer) {
+                _inner = std::move(inner);
+                _outer = &outer;
+                outer.add_ref();
+                _inner->attach(*this);
             }
 
-            value_type
-            get() {
-                wait();
-                // clang-format off
-                if (INFO_UNLIKELY_(_status == state_status::Errored)) INFO_UNLIKELY {
-                    std::rethrow_exception(_exc);
+            void
+            on_ready() noexcept override {
+                if (_inner->has_exception()) {
+                    _outer->put_exception(_inner->exception());
+                } else {
+                    try {
+                        _outer->put_value(_inner->take_value());
+                    } catch (...) {
+                        _outer->put_exception(std::current_exception());
+                    }
                 }
-                // clang-format on
-                return _value;
+                _inner.reset();
+                // may destroy this
+                _outer->release();
             }
 
-            expected<value_type, std::exception_ptr>
-            expect() {
-                wait();
-                // clang-format off
-                if (INFO_UNLIKELY_(_status == state_status::Errored)) INFO_UNLIKELY {
-                    return info::INFO_UNEXPECTED{_exc};
-                }
-                // clang-format on
-                return _value;
+        private:
+            state_ptr<future_state<T>> _inner;
+            future_state<T>* _outer = nullptr;
+        };
+
+        /// Room for forwarding the result of a continuation returning a
+        /// future. Empty for other continuations.
+        template<class R>
+        struct forward_slot { };
+        template<class S>
+        struct forward_slot<future<S>> {
+            state_forwarder<typename S::value_type> _forwarder;
+        };
+
+        /// The state of a future created by then(): once the previous state
+        /// completes, the continuation is scheduled on an executor, which
+        /// computes this state's value from the previous one. Without an
+        /// executor the continuation runs wherever the previous state completes.
+        /// The continuation is stored by its own type, in the state.
+        /// It receives the previous value as an Arg: an rvalue if this state
+        /// is the previous value's only consumer, a const reference otherwise.
+        /// If the continuation returns a future, this state completes with
+        /// that future's result, once it is available.
+        template<class Arg, class T, class Fn>
+        struct chained_state final : future_state<T>,
+                               private continuation,
+                               private forward_slot<std::decay_t<std::invoke_result_t<Fn&, Arg>>> {
+            using value_type = T;
+            using prev_type = std::remove_cv_t<std::remove_reference_t<Arg>>;
+            using result_type = std::decay_t<std::invoke_result_t<Fn&, Arg>>;
+
+            /// Attaches to the previous state. Until the continuation runs,
+            /// the previous state holds a reference to this one.
+            void
+            start() {
+                this->add_ref();
+                _last_step->attach(*this);
             }
 
             template<class Fn_>
-            chained_state(std::unique_ptr<owned_type>&& last, Fn_&& fn)
-                 : _fn(std::forward<Fn_>(fn)),
-                   _status(state_status::InProgress),
+            chained_state(state_ptr<future_state<prev_type>>&& last,
+                          Fn_&& fn,
+                          executor* exec,
+                          cancellation_token token)
+                 : future_state<T>(),
+                   _fn(std::forward<Fn_>(fn)),
                    _last_step(std::move(last)),
-                   _worker([this] {
-                       _last_step->wait();
-                       assert(_last_step->_status != state_status::InProgress);
-                       if (_last_step->_status == state_status::Errored) {
-                           new (&_exc) std::exception_ptr(std::move(_last_step->_exc));
-                           _status = state_status::Errored;
-                       } else {
-                           try {
-                               new (&_value) value_type(std::move(_fn(_last_step->_value)));
-                               _status = state_status::Completed;
-                           } catch (...) {
-                               new (&_exc) std::exception_ptr(std::current_exception());
-                               _status = state_status::Errored;
-                           }
-                       }
-                       _cv.notify_one();
-                   }) { }
-
-            chained_state(const chained_state& cp) = delete;
-            chained_state& operator=(const chained_state& cp) = delete;
-
-            chained_state(chained_state&& mv) noexcept(
-                   std::is_nothrow_move_constructible_v<value_type>&&
-                          std::is_nothrow_move_constructible_v<std::unique_ptr<owned_type>>)
-                 : _fn(std::move(mv._fn)),
-                   _status(mv._status),
-                   _last_step(std::move(mv._last_step)) {
-                switch (_status) {
-                case state_status::InProgress:
-                    return;
-                case state_status::Completed:
-                    new (&_value) value_type(std::move(mv._value));
-                    return;
-                case state_status::Errored:
-                    new (&_exc) std::exception_ptr(std::move(mv._exc));
+                   _exec(exec),
+                   _token(std::move(token)) {
+                this->set_token(_token);
+            }
+
+        private:
+            void
+            on_ready() noexcept override {
+                INFO_TRACE_FUTURE_(scheduled, this);
+                if (!_exec) {
+                    run();
+                    this->release();
                     return;
                 }
-                INFO_UNREACHABLE;
+                // the reference held by the previous state is handed to the task
+                _exec->execute([this] {
+                    run();
+                    this->release();
+                });
             }
-            chained_state&
-            operator=(chained_state&& mv) noexcept(
-                   std::is_nothrow_move_constructible_v<value_type>&&
-                          std::is_nothrow_move_assignable_v<std::unique_ptr<owned_type>>) {
-                _fn = std::move(mv._fn);
-                _status = mv._status;
-                _last_step = std::move(mv._last_step);
-                switch (_status) {
-                case state_status::InProgress:
-                    break;
-                case state_status::Completed:
-                    new (&_value) value_type(std::move(mv._value));
-                    break;
-                case state_status::Errored:
-                    new (&_exc) std::exception_ptr(std::move(mv._exc));
-                    break;
+
+            void
+            run() noexcept {
+                INFO_TRACE_FUTURE_(started, this);
+                if (_last_step->has_exception()) {
+                    this->put_exception(_last_step->exception());
+                } else if (this->token().cancelled()) {
+                    this->put_exception(std::make_exception_ptr(operation_cancelled()));
+                } else {
+                    try {
+                        if constexpr (std::is_same_v<result_type, value_type>) {
+                            this->put_value(call());
+                        } else {
+                            auto inner = call();
+                            if (!inner.valid()) throw std::future_error(std::future_errc::no_state);
+                            this->_forwarder.forward(release_state(inner), *this);
+                        }
+                    } catch (...) {
+                        this->put_exception(std::current_exception());
+                    }
                 }
-                return *this;
+                _last_step.reset();
+                INFO_TRACE_FUTURE_(finished, this);
             }
 
-            ~chained_state() noexcept(std::is_nothrow_destructible_v<value_type>) {
-                switch (_status) {
-                case state_status::InProgress: break;
-                case state_status::Completed: _value.~value_type(); break;
-                case state_status::Errored: _exc.~exception_ptr(); break;
+            decltype(auto)
+            call() {
+                if constexpr (std::is_rvalue_reference_v<Arg>) {
+                    return std::invoke(_fn, _last_step->take_value());
+                } else {
+                    return std::invoke(_fn, _last_step->value());
                 }
-                _worker.join();
             }
 
-        private:
-            template<class S_, class T_>
-            friend struct chained_state;
+            Fn _fn;
+            state_ptr<future_state<prev_type>> _last_step;
+            /// Null if the continuation runs inline.
+            executor* _exec;
+            cancellation_token _token;
+        };
 
-            std::function<value_type(const prev_type&)> _fn;
-            union {
-                value_type _value;
-                std::exception_ptr _exc;
-            };
-            state_status _status;
-            std::unique_ptr<owned_type> _last_step;
-            std::thread _worker;
+        /// Calls its stages in order, each with the result of the previous one.
+        /// Lets a chain of continuations known at once live in a single state.
+        template<class Fn, class... Fns>
+        struct pipeline {
+            template<class Arg>
+            decltype(auto)
+            operator()(Arg&& arg) {
+                return _rest(std::invoke(_fn, std::forward<Arg>(arg)));
+            }
+
+            Fn _fn;
+            pipeline<Fns...> _rest;
+        };
+
+        template<class Fn>
+        struct pipeline<Fn> {
+            template<class Arg>
+            decltype(auto)
+            operator()(Arg&& arg) {
+                return std::invoke(_fn, std::forward<Arg>(arg));
+            }
+
+            Fn _fn;
         };
 
+        template<class Fn>
+        pipeline<std::decay_t<Fn>>
+        make_pipeline(Fn&& fn) {
+            return {std::forward<Fn>(fn)};
+        }
+
+        template<class Fn, class Fn2, class... Fns>
+        pipeline<std::decay_t<Fn>, std::decay_t<Fn2>, std::decay_t<Fns>...>
+        make_pipeline(Fn&& fn, Fn2&& fn2, Fns&&... fns) {
+            return {std::forward<Fn>(fn), make_pipeline(std::forward<Fn2>(fn2), std::forward<Fns>(fns)...)};
+        }
+
+        /// A single continuation is kept as is, more are fused into a pipeline.
+        template<class Fn>
+        std::decay_t<Fn>
+        fuse(Fn&& fn) {
+            return std::forward<Fn>(fn);
+        }
+
+        template<class Fn, class Fn2, class... Fns>
+        pipeline<std::decay_t<Fn>, std::decay_t<Fn2>, std::decay_t<Fns>...>
+        fuse(Fn&& fn, Fn2&& fn2, Fns&&... fns) {
+            return make_pipeline(std::forward<Fn>(fn), std::forward<Fn2>(fn2), std::forward<Fns>(fns)...);
+        }
+
+        /// The value type of the future returned by then(fns...), whose
+        /// continuation receives the previous value as an Arg. Futures
+        /// returned by the continuation are unwrapped.
+        template<class Arg, class... Fns>
+        using chained_value_t = unwrapped_t<std::decay_t<std::invoke_result_t<decltype(fuse(std::declval<Fns>()...))&, Arg>>>;
+
+        /// Whether the first argument of then(...) is a continuation, and not
+        /// an executor or run_inline.
+        template<class Fn>
+        inline constexpr bool is_continuation_v = !std::is_base_of_v<executor, std::decay_t<Fn>>
+                                                  && !std::is_same_v<std::decay_t<Fn>, run_inline_t>;
+
+        /// Creates the state of a continuation of `last`, and attaches it.
+        template<class Arg, class... Fns>
+        state_ptr<future_state<chained_value_t<Arg, Fns...>>>
+        make_chained(state_ptr<future_state<std::remove_cv_t<std::remove_reference_t<Arg>>>> last,
+                     executor* exec,
+                     cancellation_token token,
+                     Fns&&... fns) {
+            using fn_type = decltype(fuse(std::forward<Fns>(fns)...));
+            using next_state = chained_state<Arg, chained_value_t<Arg, Fns...>, fn_type>;
+
+            auto next = state_ptr<next_state>::make(std::move(last), fuse(std::forward<Fns>(fns)...), exec, std::move(token));
+            next->start();
+            return next;
+        }
+
         template<class T>
         struct promise;
+        template<class T>
+        struct shared_future;
 
         template<class S>
         struct future {
@@ -348,6 +792,13 @@ namespace info {
                 return _state != nullptr;
             }
 
+            INFO_NODISCARD_JUST
+            bool
+            is_ready() const {
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                return _state->is_ready();
+            }
+
             void
             wait() {
                 if (!valid()) throw std::future_error(std::future_errc::no_state);
@@ -368,25 +819,119 @@ namespace info {
                 return _state->wait_until(tp);
             }
 
+            /**
+             * \brief Waits for the value, and returns a copy of it.
+             */
             value_type
-            get() {
+            get() & {
                 if (!valid()) throw std::future_error(std::future_errc::no_state);
                 return _state->get();
             }
 
+            /**
+             * \brief Waits for the value, and moves it out. Same as take().
+             */
+            value_type
+            get() && {
+                return take();
+            }
+
+            /**
+             * \brief Waits for the value, and moves it out of the future, which
+             * becomes invalid. Works for move-only types.
+             */
+            value_type
+            take() {
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                auto state = std::move(_state);
+                return state->take();
+            }
+
             expected<value_type, std::exception_ptr>
             expect() {
                 if (!valid()) throw std::future_error(std::future_errc::no_state);
                 return _state->expect();
             }
 
-            template<class Fn>
+            /**
+             * \brief Chains continuations to run on `exec` once this future completes.
+             *
+             * The continuation receives this future's value as an rvalue, so it
+             * may take ownership of it, and the returned future receives the
+             * continuation's result. Errors skip the
+             * continuation, and are propagated to the returned future.
+             *
+             * If the continuation returns a future, it is unwrapped: the
+             * returned future completes with that future's result, once it is
+             * available, without any thread waiting for it.
+             *
+             * If more continuations are given, they are fused into one step,
+             * each receiving the result of the previous one: the whole chain
+             * then takes a single shared state and a single scheduling.
+             */
+            template<class Fn, class... Fns>
+            INFO_NODISCARD("After a then call the new future should be used for "
+                           "all correspondence, the previous one is invalidated")
+            future<future_state<chained_value_t<value_type&&, Fn, Fns...>>> // clang-format off
+            then(executor& exec, Fn&& fn, Fns&&... fns) {
+                // clang-format on
+                return chain(&exec, std::forward<Fn>(fn), std::forward<Fns>(fns)...);
+            }
+
+            /**
+             * \brief Chains continuations to run inline once this future completes.
+             *
+             * \sa info::run_inline
+             */
+            template<class Fn, class... Fns>
             INFO_NODISCARD("After a then call the new future should be used for "
                            "all correspondence, the previous one is invalidated")
-            future<chained_state<S, std::invoke_result_t<Fn, const value_type&>>> // clang-format off
-            then(Fn&& fn) {
+            future<future_state<chained_value_t<value_type&&, Fn, Fns...>>> // clang-format off
+            then(run_inline_t, Fn&& fn, Fns&&... fns) {
                 // clang-format on
-                return {std::move(_state), std::forward<Fn>(fn)};
+                return chain(nullptr, std::forward<Fn>(fn), std::forward<Fns>(fns)...);
+            }
+
+            /**
+             * \brief Chains continuations to run on the default executor once this future completes.
+             *
+             * If this future is already complete, there is nothing to wait for,
+             * so the continuations are called right away instead.
+             */
+            template<class Fn, class... Fns, class = std::enable_if_t<is_continuation_v<Fn>>>
+            INFO_NODISCARD("After a then call the new future should be used for "
+                           "all correspondence, the previous one is invalidated")
+            future<future_state<chained_value_t<value_type&&, Fn, Fns...>>> // clang-format off
+            then(Fn&& fn, Fns&&... fns) {
+                // clang-format on
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                return chain(_state->is_ready() ? nullptr : &default_executor(),
+                             std::forward<Fn>(fn),
+                             std::forward<Fns>(fns)...);
+            }
+
+            /**
+             * \brief Attaches a cancellation token to the rest of the chain.
+             *
+             * The continuations chained to the returned future, and to the ones
+             * chained from it, are skipped once cancellation is requested
+             * through `token`: their futures complete with
+             * info::operation_cancelled instead.
+             */
+            INFO_NODISCARD("After a with_cancellation call the new future should be used for "
+                           "all correspondence, the previous one is invalidated")
+            future<future_state<value_type>>
+            with_cancellation(cancellation_token token) {
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                return chain_with(nullptr, std::move(token), [](value_type&& value) { return std::move(value); });
+            }
+
+            /**
+             * \brief Moves the state of this future into a shared_future.
+             */
+            shared_future<value_type>
+            share() {
+                return shared_future<value_type>(std::move(*this));
             }
 
             future() noexcept
@@ -399,25 +944,197 @@ namespace info {
                  : _state(std::move(mv._state)) { }
             future&
             operator=(future&& mv) noexcept {
+                if (_state) _state->abandon();
                 _state = std::move(mv._state);
                 return *this;
             }
 
+            /// If the future is still pending, it is abandoned: if its token
+            /// was created with info::cancel_on_abandon, cancellation is requested.
+            ~future() noexcept {
+                if (_state) _state->abandon();
+            }
+
         private:
             template<class T>
             friend struct promise;
             template<class S_>
             friend struct future; // we are our friend. Yes
+            friend struct future_access;
+            template<class S_>
+            friend state_ptr<S_> release_state(future<S_>& ftr) noexcept;
 
-            template<class... Args>
-            future(Args&&... args)
-                 : _state(std::make_unique<S>(std::forward<Args>(args)...)) { }
+            explicit future(state_ptr<S> state) noexcept
+                 : _state(std::move(state)) { }
+
+            template<class... Fns>
+            future<future_state<chained_value_t<value_type&&, Fns...>>>
+            chain(executor* exec, Fns&&... fns) {
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                auto token = _state->token();
+                return chain_with(exec, std::move(token), std::forward<Fns>(fns)...);
+            }
 
-            explicit future(unsigned)
-                 : _state(std::make_unique<S>()) {
+            template<class... Fns>
+            future<future_state<chained_value_t<value_type&&, Fns...>>>
+            chain_with(executor* exec, cancellation_token token, Fns&&... fns) {
+                return future<future_state<chained_value_t<value_type&&, Fns...>>>(
+                       make_chained<value_type&&>(std::move(_state), exec, std::move(token), std::forward<Fns>(fns)...));
             }
 
-            std::unique_ptr<S> _state;
+            state_ptr<S> _state;
+        };
+
+        template<class S>
+        state_ptr<S>
+        release_state(future<S>& ftr) noexcept {
+            return std::move(ftr._state);
+        }
+
+        template<class F>
+        struct state_of;
+        template<class S>
+        struct state_of<future<S>> {
+            using type = S;
+        };
+        /// The state type of a future type.
+        template<class F>
+        using state_of_t = typename state_of<F>::type;
+
+        /// Lets the future combinators get at the states of futures.
+        struct future_access {
+            template<class S>
+            static state_ptr<S>
+            take_state(future<S>& ftr) {
+                if (!ftr.valid()) throw std::future_error(std::future_errc::no_state);
+                return std::move(ftr._state);
+            }
+
+            template<class S>
+            static future<S>
+            make_future(state_ptr<S> state) noexcept {
+                return future<S>(std::move(state));
+            }
+
+            template<class T>
+            static state_ptr<future_state<T>>
+            share_state(const shared_future<T>& ftr) {
+                if (!ftr.valid()) throw std::future_error(std::future_errc::no_state);
+                return ftr._state;
+            }
+        };
+
+        template<class T>
+        struct shared_future {
+            using value_type = T;
+
+            INFO_NODISCARD_JUST
+            bool
+            valid() const noexcept {
+                return _state != nullptr;
+            }
+
+            INFO_NODISCARD_JUST
+            bool
+            is_ready() const {
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                return _state->is_ready();
+            }
+
+            void
+            wait() const {
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                _state->wait();
+            }
+
+            template<class Rep, class Period>
+            bool
+            wait_for(const std::chrono::duration<Rep, Period>& dur) const {
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                return _state->wait_for(dur);
+            }
+
+            template<class Clock, class Duration>
+            bool
+            wait_until(const std::chrono::time_point<Clock, Duration>& tp) const {
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                return _state->wait_until(tp);
+            }
+
+            /**
+             * \brief Waits for the value, and returns a reference to it.
+             *
+             * The reference stays valid as long as any shared_future, or
+             * continuation, referring to the same state exists.
+             */
+            const value_type&
+            get() const {
+                wait();
+                // clang-format off
+                if (INFO_UNLIKELY_(_state->has_exception())) INFO_UNLIKELY {
+                    std::rethrow_exception(_state->exception());
+                }
+                // clang-format on
+                return _state->value();
+            }
+
+            /**
+             * \brief Chains continuations to run on `exec` once the value is available.
+             *
+             * Unlike with future, any number of continuations may be chained to
+             * the same shared_future, and it stays valid. All of them receive a
+             * reference to the same value. More continuations in one call are
+             * fused into one step, like with future::then.
+             */
+            template<class Fn, class... Fns>
+            future<future_state<chained_value_t<const value_type&, Fn, Fns...>>>
+            then(executor& exec, Fn&& fn, Fns&&... fns) const {
+                return chain(&exec, std::forward<Fn>(fn), std::forward<Fns>(fns)...);
+            }
+
+            /**
+             * \brief Chains continuations to run inline once the value is available.
+             *
+             * \sa info::run_inline
+             */
+            template<class Fn, class... Fns>
+            future<future_state<chained_value_t<const value_type&, Fn, Fns...>>>
+            then(run_inline_t, Fn&& fn, Fns&&... fns) const {
+                return chain(nullptr, std::forward<Fn>(fn), std::forward<Fns>(fns)...);
+            }
+
+            /**
+             * \brief Chains continuations to run on the default executor once
+             * the value is available, or right away if it already is.
+             */
+            template<class Fn, class... Fns, class = std::enable_if_t<is_continuation_v<Fn>>>
+            future<future_state<chained_value_t<const value_type&, Fn, Fns...>>>
+            then(Fn&& fn, Fns&&... fns) const {
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                return chain(_state->is_ready() ? nullptr : &default_executor(),
+                             std::forward<Fn>(fn),
+                             std::forward<Fns>(fns)...);
+            }
+
+            shared_future() noexcept
+                 : _state(nullptr) { }
+
+            /// Takes over the state of `ftr`, leaving it invalid.
+            template<class S>
+            shared_future(future<S>&& ftr) noexcept
+                 : _state(ftr.valid() ? future_access::take_state(ftr) : nullptr) { }
+
+        private:
+            template<class... Fns>
+            future<future_state<chained_value_t<const value_type&, Fns...>>>
+            chain(executor* exec, Fns&&... fns) const {
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                return future_access::make_future(make_chained<const value_type&>(_state, exec, _state->token(), std::forward<Fns>(fns)...));
+            }
+
+            friend struct future_access;
+
+            state_ptr<future_state<value_type>> _state;
         };
 
         template<class T>
@@ -427,41 +1144,86 @@ namespace info {
 
             future_type
             get_future() {
+                if (!_state) throw std::future_error(std::future_errc::no_state);
                 if (_ftr_moved) throw std::future_error(std::future_errc::future_already_retrieved);
                 _ftr_moved = true;
-                return std::move(_ftr);
+                return future_type(_state);
             }
 
             template<class... Args>
             void
             set_value(Args&&... args) {
+                if (!_state) throw std::future_error(std::future_errc::no_state);
                 if (_set) throw std::future_error(std::future_errc::promise_already_satisfied);
+                INFO_TRACE_FUTURE_(set, _state.get());
                 _state->put_value(std::forward<Args>(args)...);
                 _set = true;
             }
 
             void
             set_exception(const std::exception_ptr& exc) {
+                if (!_state) throw std::future_error(std::future_errc::no_state);
                 if (_set) throw std::future_error(std::future_errc::promise_already_satisfied);
+                INFO_TRACE_FUTURE_(set, _state.get());
                 _state->put_exception(exc);
                 _set = true;
             }
 
+            /// Whether the result is still wanted, as told by the token the
+            /// promise was created with. Cheap enough to poll.
+            INFO_NODISCARD_JUST
+            bool
+            cancelled() const noexcept {
+                return _state && _state->token().cancelled();
+            }
+
+            INFO_NODISCARD_JUST
+            cancellation_token
+            token() const {
+                if (!_state) throw std::future_error(std::future_errc::no_state);
+                return _state->token();
+            }
+
             promise()
-                 : _ftr(0xDEADBEEF),
-                   _state(_ftr._state.get()),
+                 : _state(state_ptr<future_state<value_type>>::make()),
                    _set(false),
                    _ftr_moved(false) { }
 
+            /// Creates a promise whose future, and the continuations chained
+            /// to it, observe `token`.
+            explicit promise(cancellation_token token)
+                 : _state(state_ptr<cancellable_state<future_state<value_type>>>::make(std::move(token))),
+                   _set(false),
+                   _ftr_moved(false) { }
+
+            promise(const promise& cp) = delete;
+            promise& operator=(const promise& cp) = delete;
+
+            promise(promise&& mv) noexcept
+                 : _state(std::move(mv._state)),
+                   _set(mv._set),
+                   _ftr_moved(mv._ftr_moved) { }
+            promise&
+            operator=(promise&& mv) noexcept {
+                promise(std::move(mv)).swap(*this);
+                return *this;
+            }
+
+            void
+            swap(promise& other) noexcept {
+                _state.swap(other._state);
+                std::swap(_set, other._set);
+                std::swap(_ftr_moved, other._ftr_moved);
+            }
+
             ~promise() noexcept {
-                if (!_set && _ftr_moved)
+                if (_state && !_set && _ftr_moved)
                     _state->put_exception(std::make_exception_ptr(
                            std::future_error(std::future_errc::broken_promise)));
             };
 
         private:
-            future_type _ftr;
-            future_state<value_type>* _state;
+            state_ptr<future_state<value_type>> _state;
             bool _set;
             bool _ftr_moved;
         };
@@ -471,4 +1233,6 @@ namespace info {
     using future = impl::future<impl::future_state<T>>;
     template<class T>
     using promise = impl::promise<T>;
+    template<class T>
+    using shared_future = impl::shared_future<T>;
 }
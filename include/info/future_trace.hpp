@@ -0,0 +1,276 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+// Opt-in tracing of future chains. If INFO_TRACE_FUTURES is defined, the
+// shared states of futures record their life cycle into per-thread buffers,
+// which info::write_future_trace dumps as Chrome trace-event JSON, viewable in
+// Perfetto or chrome://tracing. Otherwise the hooks expand to nothing.
+//
+// The macro changes the definition of every future type, so it must be the
+// same in all translation units of a program.
+
+#ifdef INFO_TRACE_FUTURES
+#    include <atomic>
+#    include <chrono>
+#    include <cstddef>
+#    include <cstdint>
+#    include <ostream>
+
+#    include <info/_macros.hpp>
+
+/// The number of events a thread can record, before it starts dropping them.
+#    ifndef INFO_TRACE_FUTURES_CAPACITY
+#        define INFO_TRACE_FUTURES_CAPACITY 65536
+#    endif
+
+#    define INFO_TRACE_FUTURE_(KIND, STATE) \
+        ::info::impl::trace_future(::info::impl::trace_kind::KIND,                    \
+                                   static_cast<const ::info::impl::state_base*>(STATE)->trace_id())
+
+namespace info {
+    namespace impl {
+        enum class trace_kind : std::uint8_t {
+            /// A shared state was created.
+            created,
+            /// A shared state completed.
+            ready,
+            /// A promise stored a value or an exception.
+            set,
+            /// A continuation was handed to an executor.
+            scheduled,
+            /// A continuation started running.
+            started,
+            /// A continuation finished running.
+            finished,
+        };
+
+        struct trace_event {
+            std::uint64_t state;
+            std::int64_t nanos;
+            trace_kind kind;
+        };
+
+        /// Hands out the ids states are traced by. Addresses would not do:
+        /// the state caches reuse them.
+        inline std::atomic<std::uint64_t> trace_state_ids{0};
+
+        inline std::uint64_t
+        next_trace_id() noexcept {
+            return trace_state_ids.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+
+        /// The events of one thread. Only that thread writes it, and it is
+        /// never freed, so it can be dumped after the thread exited. Once the
+        /// thread exits, the next thread to start tracing takes it over,
+        /// keeping its events and its id.
+        struct trace_buffer {
+            constexpr const static std::size_t capacity = INFO_TRACE_FUTURES_CAPACITY;
+
+            void
+            record(trace_kind kind, std::uint64_t state) noexcept {
+                const auto size = _size.load(std::memory_order_relaxed);
+                if (INFO_UNLIKELY_(size == capacity)) {
+                    _dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                const auto now = std::chrono::steady_clock::now().time_since_epoch();
+                _events[size] = {state, std::chrono::duration_cast<std::chrono::nanoseconds>(now).count(), kind};
+                _size.store(size + 1, std::memory_order_release);
+            }
+
+            explicit trace_buffer(std::uint32_t tid) noexcept
+                 : _tid(tid) { }
+
+            trace_event _events[capacity];
+            std::atomic<std::size_t> _size{0};
+            std::atomic<std::size_t> _dropped{0};
+            /// Whether a running thread records into the buffer.
+            std::atomic<bool> _in_use{true};
+            const std::uint32_t _tid;
+            /// The buffer registered before this one.
+            trace_buffer* _next = nullptr;
+        };
+
+        /// Every buffer ever registered, most recent first.
+        inline std::atomic<trace_buffer*> trace_buffers{nullptr};
+        inline std::atomic<std::uint32_t> trace_thread_ids{0};
+
+        /// Takes over the buffer of an exited thread, or registers a new one.
+        inline trace_buffer*
+        acquire_trace_buffer() {
+            for (auto buf = trace_buffers.load(std::memory_order_acquire); buf; buf = buf->_next) {
+                auto in_use = false;
+                if (buf->_in_use.compare_exchange_strong(in_use, true, std::memory_order_acquire)) return buf;
+            }
+
+            auto buf = new trace_buffer(trace_thread_ids.fetch_add(1, std::memory_order_relaxed) + 1);
+            auto head = trace_buffers.load(std::memory_order_relaxed);
+            do {
+                buf->_next = head;
+            } while (!trace_buffers.compare_exchange_weak(head, buf, std::memory_order_release, std::memory_order_relaxed));
+            return buf;
+        }
+
+        /// The calling thread's buffer, and whether the thread already handed
+        /// it back. Trivially destructible, so still usable while the thread exits.
+        inline thread_local trace_buffer* trace_thread_buffer = nullptr;
+        inline thread_local bool trace_thread_exited = false;
+
+        /// Hands the calling thread's buffer back when the thread exits.
+        struct trace_buffer_owner {
+            ~trace_buffer_owner() noexcept {
+                trace_thread_buffer->_in_use.store(false, std::memory_order_release);
+                trace_thread_buffer = nullptr;
+                trace_thread_exited = true;
+            }
+        };
+
+        inline void
+        trace_future(trace_kind kind, std::uint64_t state) noexcept {
+            if (INFO_UNLIKELY_(!trace_thread_buffer)) {
+                // events recorded while the thread exits are dropped
+                if (trace_thread_exited) return;
+                try {
+                    trace_thread_buffer = acquire_trace_buffer();
+                } catch (...) {
+                    return;
+                }
+                thread_local trace_buffer_owner owner;
+                static_cast<void>(owner);
+            }
+            trace_thread_buffer->record(kind, state);
+        }
+
+        /// Trace timestamps are in microseconds; keeps the nanoseconds as decimals.
+        inline void
+        write_trace_micros(std::ostream& os, std::int64_t nanos) {
+            const auto frac = nanos % 1000;
+            os << nanos / 1000 << '.'
+               << static_cast<char>('0' + frac / 100)
+               << static_cast<char>('0' + frac / 10 % 10)
+               << static_cast<char>('0' + frac % 10);
+        }
+
+        inline void
+        write_trace_event(std::ostream& os, const trace_event& ev, std::uint32_t tid) {
+            // async events of the same id nest: a future's life, from creation
+            // to completion, contains the time its continuation spent queued
+            const char* name = "future";
+            const char* phase = "b";
+            switch (ev.kind) {
+            case trace_kind::created:
+                break;
+            case trace_kind::ready:
+                phase = "e";
+                break;
+            case trace_kind::set:
+                name = "set";
+                phase = "n";
+                break;
+            case trace_kind::scheduled:
+                name = "queued";
+                break;
+            case trace_kind::started:
+                name = "continuation";
+                phase = "B";
+                break;
+            case trace_kind::finished:
+                name = "continuation";
+                phase = "E";
+                break;
+            }
+
+            os << R"({"name":")" << name
+               << R"(","cat":"future","ph":")" << phase
+               << R"(","pid":1,"tid":)" << tid
+               << R"(,"ts":)";
+            write_trace_micros(os, ev.nanos);
+            if (ev.kind == trace_kind::started || ev.kind == trace_kind::finished) {
+                os << R"(,"args":{"state":")" << ev.state << R"("}})";
+            } else {
+                os << R"(,"id":")" << ev.state << R"("})";
+            }
+            if (ev.kind == trace_kind::started) {
+                // the queued span of the state ends where its continuation starts
+                os << ",\n"
+                   << R"({"name":"queued","cat":"future","ph":"e","pid":1,"tid":)" << tid
+                   << R"(,"ts":)";
+                write_trace_micros(os, ev.nanos);
+                os << R"(,"id":")" << ev.state << R"("})";
+            }
+        }
+    }
+
+    /**
+     * \brief Writes the events recorded so far as Chrome trace-event JSON.
+     *
+     * Each future is an async slice from its creation to its completion, with
+     * a nested slice for the time its continuation waited for an executor.
+     * Continuations running are slices on their threads, and promises being
+     * satisfied are instant events. Without INFO_TRACE_FUTURES, an empty
+     * trace is written.
+     *
+     * Safe to call while futures are being traced; events recorded meanwhile
+     * may be missing from the output.
+     *
+     * \return The number of events dropped because a thread's buffer was full.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    inline std::size_t
+    write_future_trace(std::ostream& os) {
+        std::size_t dropped = 0;
+        bool first = true;
+        os << R"({"displayTimeUnit":"ns","traceEvents":[)";
+        for (auto buf = impl::trace_buffers.load(std::memory_order_acquire); buf; buf = buf->_next) {
+            const auto size = buf->_size.load(std::memory_order_acquire);
+            for (std::size_t i = 0; i < size; ++i) {
+                os << (first ? "\n" : ",\n");
+                first = false;
+                impl::write_trace_event(os, buf->_events[i], buf->_tid);
+            }
+            dropped += buf->_dropped.load(std::memory_order_relaxed);
+        }
+        os << "\n]}\n";
+        return dropped;
+    }
+
+    /**
+     * \brief Discards the events recorded so far.
+     *
+     * Must not be called while futures are being traced on other threads.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    inline void
+    clear_future_trace() noexcept {
+        for (auto buf = impl::trace_buffers.load(std::memory_order_acquire); buf; buf = buf->_next) {
+            buf->_size.store(0, std::memory_order_release);
+            buf->_dropped.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+#else
+#    include <cstddef>
+#    include <iosfwd>
+
+#    define INFO_TRACE_FUTURE_(KIND, STATE) ((void) 0)
+
+namespace info {
+    /// A template, so only its callers need <ostream>.
+    template<class Traits>
+    std::size_t
+    write_future_trace(std::basic_ostream<char, Traits>& os) {
+        os << R"({"traceEvents":[]})" << '\n';
+        return 0;
+    }
+
+    inline void
+    clear_future_trace() noexcept { }
+}
+#endif
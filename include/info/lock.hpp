@@ -0,0 +1,236 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <exception>
+
+#include <info/_hardware.hpp>
+#include <info/_macros.hpp>
+
+namespace info {
+    /**
+     * \brief A test-and-test-and-set spinlock with exponential backoff.
+     *
+     * Satisfies Lockable. Best suited for very short critical sections with
+     * low contention, as it is unfair and never parks the thread in the kernel.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct spinlock {
+        void
+        lock() noexcept {
+            for (;;) {
+                if (!_locked.exchange(true, std::memory_order_acquire)) return;
+
+                impl::backoff wait;
+                while (_locked.load(std::memory_order_relaxed)) wait();
+            }
+        }
+
+        INFO_NODISCARD_JUST
+        bool
+        try_lock() noexcept {
+            return !_locked.load(std::memory_order_relaxed)
+                   && !_locked.exchange(true, std::memory_order_acquire);
+        }
+
+        void
+        unlock() noexcept {
+            _locked.store(false, std::memory_order_release);
+        }
+
+        spinlock() noexcept = default;
+        spinlock(const spinlock& cp) = delete;
+        spinlock& operator=(const spinlock& cp) = delete;
+
+    private:
+        std::atomic<bool> _locked{false};
+    };
+
+    /**
+     * \brief A FIFO-fair ticket lock with proportional backoff.
+     *
+     * Satisfies Lockable. Threads are granted the lock in the order they
+     * requested it; waiters back off proportionally to their distance from
+     * the head of the line.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct ticket_lock {
+        void
+        lock() noexcept {
+            const auto ticket = _next.fetch_add(1, std::memory_order_relaxed);
+            auto last_serving = _serving.load(std::memory_order_acquire);
+            impl::backoff stalled;
+            for (;;) {
+                const auto serving = _serving.load(std::memory_order_acquire);
+                if (serving == ticket) return;
+
+                const auto ahead = ticket - serving;
+                if (ahead > yield_distance) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (std::uint32_t i = 0; i < ahead * spins_per_waiter; ++i) impl::cpu_relax();
+
+                // the line has not moved: the holder or a waiter before us is
+                // likely preempted, so stop burning its CPU time
+                if (serving == last_serving) {
+                    stalled();
+                } else {
+                    last_serving = serving;
+                    stalled.reset();
+                }
+            }
+        }
+
+        INFO_NODISCARD_JUST
+        bool
+        try_lock() noexcept {
+            auto serving = _serving.load(std::memory_order_acquire);
+            return _next.compare_exchange_strong(serving, serving + 1,
+                                                 std::memory_order_acquire,
+                                                 std::memory_order_relaxed);
+        }
+
+        void
+        unlock() noexcept {
+            _serving.store(_serving.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_release);
+        }
+
+        ticket_lock() noexcept = default;
+        ticket_lock(const ticket_lock& cp) = delete;
+        ticket_lock& operator=(const ticket_lock& cp) = delete;
+
+    private:
+        constexpr const static std::uint32_t spins_per_waiter = 32;
+        constexpr const static std::uint32_t yield_distance = 8;
+
+        alignas(impl::cache_line_size) std::atomic<std::uint32_t> _next{0};
+        alignas(impl::cache_line_size) std::atomic<std::uint32_t> _serving{0};
+    };
+
+    namespace impl {
+        struct alignas(cache_line_size) mcs_node {
+            std::atomic<mcs_node*> _next{nullptr};
+            std::atomic<bool> _locked{false};
+            bool _in_use = false;
+        };
+
+        /// Each thread owns a small set of queue nodes, so it can hold
+        /// several mcs_locks at once, and release them in any order.
+        struct mcs_node_pool {
+            constexpr const static std::size_t size = 8;
+
+            static mcs_node*
+            acquire() noexcept {
+                for (auto& node : nodes()) {
+                    if (!node._in_use) {
+                        node._in_use = true;
+                        return &node;
+                    }
+                }
+                assert(false && "mcs_lock: too many mcs_locks held by one thread");
+                std::terminate();
+            }
+
+            static void
+            release(mcs_node* node) noexcept {
+                node->_in_use = false;
+            }
+
+        private:
+            static std::array<mcs_node, size>&
+            nodes() noexcept {
+                thread_local std::array<mcs_node, size> pool;
+                return pool;
+            }
+        };
+    }
+
+    /**
+     * \brief A Mellor-Crummey-Scott queue lock.
+     *
+     * Satisfies Lockable. Every waiter spins on its own, thread-local queue
+     * node, instead of on the lock word, so handing the lock over only touches
+     * the cache line of the next waiter. This makes it scale under heavy
+     * contention, where a spinlock or ticket_lock would cause cache line
+     * ping-pong between all waiters. Acquisition is FIFO-fair.
+     *
+     * A thread may hold at most `impl::mcs_node_pool::size` mcs_locks at once.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct mcs_lock {
+        void
+        lock() noexcept {
+            auto node = impl::mcs_node_pool::acquire();
+            node->_next.store(nullptr, std::memory_order_relaxed);
+            node->_locked.store(true, std::memory_order_relaxed);
+
+            if (auto prev = _tail.exchange(node, std::memory_order_acq_rel)) {
+                prev->_next.store(node, std::memory_order_release);
+
+                impl::backoff wait;
+                while (node->_locked.load(std::memory_order_acquire)) wait();
+            }
+            _holder = node;
+        }
+
+        INFO_NODISCARD_JUST
+        bool
+        try_lock() noexcept {
+            auto node = impl::mcs_node_pool::acquire();
+            node->_next.store(nullptr, std::memory_order_relaxed);
+
+            impl::mcs_node* expected = nullptr;
+            if (_tail.compare_exchange_strong(expected, node,
+                                              std::memory_order_acq_rel,
+                                              std::memory_order_relaxed)) {
+                _holder = node;
+                return true;
+            }
+            impl::mcs_node_pool::release(node);
+            return false;
+        }
+
+        void
+        unlock() noexcept {
+            auto node = _holder;
+            auto next = node->_next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                auto expected = node;
+                if (_tail.compare_exchange_strong(expected, nullptr,
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed)) {
+                    impl::mcs_node_pool::release(node);
+                    return;
+                }
+
+                // a successor is enqueuing itself, wait for it to link up
+                impl::backoff wait;
+                while ((next = node->_next.load(std::memory_order_acquire)) == nullptr) wait();
+            }
+            next->_locked.store(false, std::memory_order_release);
+            impl::mcs_node_pool::release(node);
+        }
+
+        mcs_lock() noexcept = default;
+        mcs_lock(const mcs_lock& cp) = delete;
+        mcs_lock& operator=(const mcs_lock& cp) = delete;
+
+    private:
+        std::atomic<impl::mcs_node*> _tail{nullptr};
+        impl::mcs_node* _holder = nullptr;
+    };
+}
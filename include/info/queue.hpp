@@ -5,17 +5,32 @@
 #pragma once
 
 #include <cassert>
+#include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <atomic>
+#include <type_traits>
 
 #include <info/_macros.hpp>
 
 namespace info {
-    template<class T>
+    /**
+     * \brief A thread-safe, unbounded FIFO queue.
+     *
+     * The head and tail of the queue are guarded by separate locks of type
+     * `Lock`, so producers and consumers do not contend with each other.
+     * `Lock` may be any Lockable type; the spinning locks of `<info/lock.hpp>`
+     * may be preferred over `std::mutex` for queues with very short critical
+     * sections.
+     *
+     * \tparam T The element type.
+     * \tparam Lock The lock type guarding the ends of the queue.
+     */
+    template<class T, class Lock = std::mutex>
     struct queue {
         using value_type = T;
+        using lock_type = Lock;
         static_assert(std::is_move_constructible_v<value_type>,
                       "queue<T>: T must be move constructible");
 
@@ -32,8 +47,15 @@ namespace info {
                 _tail->put_value(std::forward<Args>(args)...);
                 _tail->_next = std::move(nxt);
                 _tail = nxt_tail;
+                _size.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (_waiters.load() != 0) {
+                // a consumer may have found the queue empty, but not be waiting
+                // yet: it holds the head lock until it is, so taking it here
+                // ensures the notification reaches it
+                { std::scoped_lock lck(_m_head); }
+                _cv.notify_one();
             }
-            _cv.notify_one();
         }
 
         INFO_NODISCARD_JUST
@@ -54,10 +76,48 @@ namespace info {
             return std::make_unique<value_type>(std::move(head->_value));
         }
 
+        /**
+         * \brief Waits at most `dur` for an element to become available.
+         *
+         * Returns nullptr if the queue is ended, or if no element became available in time.
+         */
+        template<class Rep, class Period>
+        INFO_NODISCARD_JUST
+        std::unique_ptr<value_type>
+        await_pop_for(const std::chrono::duration<Rep, Period>& dur) {
+            std::unique_lock lck(_m_head);
+            _waiters.fetch_add(1);
+            const auto ready = _cv.wait_for(lck, dur, [this] { return _head.get() != tail() || _end; });
+            _waiters.fetch_sub(1);
+            if (!ready || _end) return nullptr;
+            auto head = unlocked_pop();
+            if (!head) return nullptr;
+            return std::make_unique<value_type>(std::move(head->_value));
+        }
+
+        /**
+         * \brief The number of elements in the queue.
+         *
+         * Only a snapshot, which may be outdated by the time it is returned
+         * if other threads use the queue.
+         */
+        INFO_NODISCARD_JUST
+        std::size_t
+        size() const noexcept {
+            return _size.load(std::memory_order_relaxed);
+        }
+
+        INFO_NODISCARD_JUST
+        bool
+        ended() const noexcept {
+            return _end;
+        }
+
         void
         end() {
             if (!_end) {
                 _end = true;
+                { std::scoped_lock lck(_m_head); }
                 _cv.notify_all();
             }
         }
@@ -66,6 +126,8 @@ namespace info {
              : _head(std::make_unique<node>()),
                _tail(_head.get()),
                _end(false),
+               _waiters(0),
+               _size(0),
                _m_head(),
                _m_tail(),
                _cv() { }
@@ -111,6 +173,7 @@ namespace info {
 
             auto old = std::move(_head);
             _head = std::move(old->_next);
+            _size.fetch_sub(1, std::memory_order_relaxed);
 
             return old;
         }
@@ -127,18 +190,30 @@ namespace info {
             return _tail;
         }
 
-        std::unique_lock<std::mutex>
+        std::unique_lock<lock_type>
         await() {
             std::unique_lock lck(_m_head);
+            // consumers announce themselves before checking the tail, and keep
+            // the head lock until they wait: a producer either finds no waiters,
+            // in which case they see its new element, or it takes the head lock
+            // before notifying, by which time they are waiting
+            _waiters.fetch_add(1);
             _cv.wait(lck, [this] { return _head.get() != tail() || _end; });
+            _waiters.fetch_sub(1);
             return lck;
         }
 
+        using condition_type = std::conditional_t<std::is_same_v<lock_type, std::mutex>,
+                                                  std::condition_variable,
+                                                  std::condition_variable_any>;
+
         std::unique_ptr<node> _head;
         node* _tail;
         std::atomic<bool> _end;
-        std::mutex _m_head;
-        std::mutex _m_tail;
-        std::condition_variable _cv;
+        std::atomic<std::size_t> _waiters;
+        std::atomic<std::size_t> _size;
+        lock_type _m_head;
+        lock_type _m_tail;
+        condition_type _cv;
     };
 }
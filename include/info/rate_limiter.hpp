@@ -0,0 +1,167 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <info/_macros.hpp>
+#include <info/queue.hpp>
+
+namespace info {
+    /**
+     * \brief A lock-free token bucket.
+     *
+     * Tokens are replenished at `rate` per second, and at most `burst` of them
+     * may be accumulated. Implemented as the generic cell rate algorithm: the
+     * whole state is a single atomic holding the theoretical arrival time of
+     * the next request, so checking the limiter is a load and, if a token is
+     * available, a compare-exchange. Rejected requests do not write the state.
+     *
+     * Rates are resolved to whole nanoseconds between tokens, so at most 10^9
+     * tokens per second are supported.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct rate_limiter {
+        using clock = std::chrono::steady_clock;
+
+        /**
+         * \brief Takes `n` tokens if they are available right now.
+         */
+        INFO_NODISCARD_JUST
+        bool
+        try_acquire(std::size_t n = 1) noexcept {
+            const auto now = now_ns();
+            const auto cost = static_cast<std::int64_t>(n) * _interval;
+            auto tat = _tat.load(std::memory_order_relaxed);
+            for (;;) {
+                const auto next = std::max(tat, now) + cost;
+                if (next - now > _tolerance) return false;
+                if (_tat.compare_exchange_weak(tat, next, std::memory_order_relaxed)) return true;
+            }
+        }
+
+        /**
+         * \brief Unconditionally takes `n` tokens, and returns the point in time
+         * at which they become available.
+         *
+         * The returned time point may be in the past, if the tokens were
+         * available immediately.
+         */
+        clock::time_point
+        reserve(std::size_t n = 1) noexcept {
+            const auto now = now_ns();
+            const auto cost = static_cast<std::int64_t>(n) * _interval;
+            auto tat = _tat.load(std::memory_order_relaxed);
+            std::int64_t next;
+            do {
+                next = std::max(tat, now) + cost;
+            } while (!_tat.compare_exchange_weak(tat, next, std::memory_order_relaxed));
+            return clock::time_point(std::chrono::duration_cast<clock::duration>(
+                   std::chrono::nanoseconds(next - _tolerance)));
+        }
+
+        /**
+         * \brief Takes `n` tokens, sleeping until they are available if necessary.
+         */
+        void
+        acquire(std::size_t n = 1) {
+            const auto deadline = reserve(n);
+            if (deadline > clock::now()) std::this_thread::sleep_until(deadline);
+        }
+
+        /**
+         * \param rate The number of tokens replenished per second.
+         * \param burst The maximum number of tokens that can be taken at once.
+         */
+        rate_limiter(double rate, std::size_t burst)
+             : _interval(std::max(std::int64_t{1}, static_cast<std::int64_t>(1e9 / rate))),
+               _tolerance(static_cast<std::int64_t>(std::max(burst, std::size_t{1})) * _interval),
+               _tat(now_ns()) { }
+
+        rate_limiter(const rate_limiter& cp) = delete;
+        rate_limiter& operator=(const rate_limiter& cp) = delete;
+
+    private:
+        static std::int64_t
+        now_ns() noexcept {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          clock::now().time_since_epoch())
+                   .count();
+        }
+
+        /// Nanoseconds between two tokens.
+        const std::int64_t _interval;
+        /// How far ahead of now the theoretical arrival time may run.
+        const std::int64_t _tolerance;
+        /// The theoretical arrival time, in nanoseconds since the clock's epoch.
+        std::atomic<std::int64_t> _tat;
+    };
+
+    /**
+     * \brief Applies a rate_limiter to pushes into an info::queue.
+     *
+     * Popping is done through the underlying queue directly.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    template<class T, class Lock = std::mutex>
+    struct rate_limited_queue {
+        using value_type = T;
+        using queue_type = queue<value_type, Lock>;
+
+        /**
+         * \brief Pushes an element if the rate allows it right now.
+         *
+         * \return Whether the element was pushed.
+         */
+        template<class... Args>
+        bool
+        try_push(Args&&... args) {
+            if (!_limiter.try_acquire()) return false;
+            _queue.push(std::forward<Args>(args)...);
+            return true;
+        }
+
+        /**
+         * \brief Pushes an element, sleeping until the rate allows it.
+         */
+        template<class... Args>
+        void
+        push(Args&&... args) {
+            _limiter.acquire();
+            _queue.push(std::forward<Args>(args)...);
+        }
+
+        INFO_NODISCARD_JUST
+        queue_type&
+        underlying() noexcept {
+            return _queue;
+        }
+
+        INFO_NODISCARD_JUST
+        rate_limiter&
+        limiter() noexcept {
+            return _limiter;
+        }
+
+        rate_limited_queue(queue_type& queue, double rate, std::size_t burst)
+             : _queue(queue),
+               _limiter(rate, burst) { }
+
+    private:
+        queue_type& _queue;
+        rate_limiter _limiter;
+    };
+}
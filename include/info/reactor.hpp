@@ -0,0 +1,340 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+// An I/O reactor completing futures from file descriptor readiness.
+// Only available on Linux, where it is built on epoll.
+#if defined(__linux__) && __has_include(<sys/epoll.h>)
+#    define INFO_HAS_REACTOR 1
+
+#    include <algorithm>
+#    include <atomic>
+#    include <cerrno>
+#    include <chrono>
+#    include <cstddef>
+#    include <cstdint>
+#    include <mutex>
+#    include <system_error>
+#    include <unordered_map>
+#    include <utility>
+#    include <vector>
+
+#    include <sys/epoll.h>
+#    include <sys/eventfd.h>
+#    include <unistd.h>
+
+#    include <info/_macros.hpp>
+#    include <info/cancellation.hpp>
+#    include <info/executor.hpp>
+#    include <info/future.hpp>
+
+namespace info {
+    /**
+     * \brief Readiness conditions of a file descriptor, as reported by epoll.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    enum class io_events : std::uint32_t {
+        none = 0,
+        readable = EPOLLIN,
+        writable = EPOLLOUT,
+        priority = EPOLLPRI,
+        /// Always reported, even if not asked for.
+        error = EPOLLERR,
+        /// Always reported, even if not asked for.
+        hangup = EPOLLHUP,
+        read_hangup = EPOLLRDHUP,
+    };
+
+    constexpr io_events
+    operator|(io_events lhs, io_events rhs) noexcept {
+        return static_cast<io_events>(static_cast<std::uint32_t>(lhs) | static_cast<std::uint32_t>(rhs));
+    }
+
+    constexpr io_events
+    operator&(io_events lhs, io_events rhs) noexcept {
+        return static_cast<io_events>(static_cast<std::uint32_t>(lhs) & static_cast<std::uint32_t>(rhs));
+    }
+
+    /// Whether any of the events in `which` are set in `events`.
+    constexpr bool
+    any_of(io_events events, io_events which) noexcept {
+        return (events & which) != io_events::none;
+    }
+
+    /**
+     * \brief Completes futures when file descriptors become ready.
+     *
+     * Built on Linux epoll. when_ready() registers interest in a descriptor,
+     * and returns a future which the thread running the reactor completes
+     * with the events that occurred, once one of them does. Interest is
+     * one-shot: after the future completes, wait again with another
+     * when_ready() call. One thread running the reactor can serve any number
+     * of descriptors, instead of one thread blocking on each.
+     *
+     * The reactor is also an executor: tasks given to it are run by the
+     * thread running it, so continuations can be chained onto the reactor
+     * thread. The thread is woken through an eventfd.
+     *
+     * when_ready(), forget(), execute(), and stop() may be called from any
+     * thread; run() and run_once() from one thread at a time.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct reactor final : executor {
+        /**
+         * \brief Returns a future completed once `fd` is ready for any of `interest`.
+         *
+         * The future's value holds every event which occurred, which may
+         * include io_events::error and io_events::hangup. Any number of
+         * waiters may wait on the same descriptor, for the same or different
+         * events.
+         *
+         * \throws std::system_error if epoll refuses the descriptor.
+         */
+        future<io_events>
+        when_ready(int fd, io_events interest) {
+            promise<io_events> p;
+            auto ftr = p.get_future();
+
+            std::scoped_lock lck(_mtx);
+            auto& entry = _fds[fd];
+            entry.waiters.push_back({interest, std::move(p)});
+            try {
+                arm(fd, entry);
+            } catch (...) {
+                entry.waiters.pop_back();
+                if (entry.waiters.empty() && !entry.registered) _fds.erase(fd);
+                throw;
+            }
+            return ftr;
+        }
+
+        /**
+         * \brief Stops watching `fd`. Pending waiters complete with
+         * info::operation_cancelled.
+         *
+         * To be called before closing the descriptor.
+         */
+        void
+        forget(int fd) {
+            std::vector<waiter> waiters;
+            {
+                std::scoped_lock lck(_mtx);
+                const auto it = _fds.find(fd);
+                if (it == _fds.end()) return;
+                if (it->second.registered) ::epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, nullptr);
+                waiters = std::move(it->second.waiters);
+                _fds.erase(it);
+            }
+            for (auto& w : waiters) {
+                w.done.set_exception(std::make_exception_ptr(operation_cancelled()));
+            }
+        }
+
+        /// Runs `task` on the thread running the reactor.
+        void
+        execute(task_type task) override {
+            bool wake;
+            {
+                std::scoped_lock lck(_mtx);
+                wake = _posted.empty();
+                _posted.push_back(std::move(task));
+            }
+            if (wake) notify();
+        }
+
+        /**
+         * \brief Waits for events, at most for `timeout`, and handles them.
+         *
+         * Completes the futures of the ready descriptors, and runs the tasks
+         * posted meanwhile. A negative timeout waits indefinitely.
+         *
+         * \return The number of futures completed and tasks run.
+         */
+        std::size_t
+        run_once(std::chrono::milliseconds timeout = std::chrono::milliseconds(-1)) {
+            epoll_event events[max_events];
+            const auto ms = timeout.count() < 0 ? -1 : static_cast<int>(timeout.count());
+            const auto n = ::epoll_wait(_epoll, events, max_events, ms);
+            if (n < 0) {
+                if (errno == EINTR) return 0;
+                throw std::system_error(errno, std::system_category(), "epoll_wait");
+            }
+
+            std::size_t handled = 0;
+            bool posted = false;
+            std::vector<std::pair<promise<io_events>, io_events>> ready;
+            {
+                std::scoped_lock lck(_mtx);
+                for (int i = 0; i < n; ++i) {
+                    if (events[i].data.fd == _wakeup) {
+                        posted = true;
+                        continue;
+                    }
+                    collect(events[i].data.fd, static_cast<io_events>(events[i].events), ready);
+                }
+            }
+            // outside the lock: continuations may register again
+            for (auto& [p, ev] : ready) p.set_value(ev);
+            handled += ready.size();
+
+            if (posted) handled += run_posted();
+            return handled;
+        }
+
+        /// Handles events until stop() is called.
+        void
+        run() {
+            while (!_stopped.load(std::memory_order_acquire)) run_once();
+        }
+
+        /// Makes run() return, once it finished handling the current events.
+        void
+        stop() noexcept {
+            _stopped.store(true, std::memory_order_release);
+            notify();
+        }
+
+        INFO_NODISCARD_JUST
+        bool
+        stopped() const noexcept {
+            return _stopped.load(std::memory_order_acquire);
+        }
+
+        /// The epoll descriptor.
+        INFO_NODISCARD_JUST
+        int
+        native_handle() const noexcept {
+            return _epoll;
+        }
+
+        /// \throws std::system_error if the epoll or eventfd descriptors cannot be created.
+        reactor()
+             : _epoll(::epoll_create1(EPOLL_CLOEXEC)),
+               _wakeup(-1) {
+            if (_epoll < 0) throw std::system_error(errno, std::system_category(), "epoll_create1");
+            _wakeup = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (_wakeup < 0) {
+                const auto err = errno;
+                ::close(_epoll);
+                throw std::system_error(err, std::system_category(), "eventfd");
+            }
+
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = _wakeup;
+            if (::epoll_ctl(_epoll, EPOLL_CTL_ADD, _wakeup, &ev) < 0) {
+                const auto err = errno;
+                ::close(_wakeup);
+                ::close(_epoll);
+                throw std::system_error(err, std::system_category(), "epoll_ctl");
+            }
+        }
+
+        reactor(const reactor& cp) = delete;
+        reactor& operator=(const reactor& cp) = delete;
+
+        /// Pending futures complete with a broken promise error.
+        ~reactor() noexcept override {
+            _fds.clear();
+            ::close(_wakeup);
+            ::close(_epoll);
+        }
+
+    private:
+        constexpr const static int max_events = 64;
+
+        struct waiter {
+            io_events interest;
+            promise<io_events> done;
+        };
+
+        struct fd_entry {
+            std::vector<waiter> waiters;
+            /// Whether the descriptor was added to the epoll set.
+            bool registered = false;
+        };
+
+        /// (Re)arms the one-shot registration of `fd` with what its waiters
+        /// are interested in. Called with the lock held.
+        void
+        arm(int fd, fd_entry& entry) {
+            std::uint32_t interest = 0;
+            for (const auto& w : entry.waiters) interest |= static_cast<std::uint32_t>(w.interest);
+
+            epoll_event ev{};
+            ev.events = interest | EPOLLONESHOT;
+            ev.data.fd = fd;
+            if (::epoll_ctl(_epoll, entry.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev) < 0) {
+                throw std::system_error(errno, std::system_category(), "epoll_ctl");
+            }
+            entry.registered = true;
+        }
+
+        /// Moves the waiters satisfied by `events` into `ready`, and rearms
+        /// the descriptor for the rest. Called with the lock held.
+        void
+        collect(int fd,
+                io_events events,
+                std::vector<std::pair<promise<io_events>, io_events>>& ready) {
+            const auto it = _fds.find(fd);
+            if (it == _fds.end()) return;
+            auto& waiters = it->second.waiters;
+            // the only allocation, before anything moves: nothing is lost if it throws
+            ready.reserve(ready.size() + waiters.size());
+
+            // errors and hangups wake everyone, so they can find out
+            const auto failed = any_of(events, io_events::error | io_events::hangup);
+            const auto end = std::partition(waiters.begin(), waiters.end(), [&](const waiter& w) {
+                return !failed && !any_of(events, w.interest);
+            });
+            for (auto w = end; w != waiters.end(); ++w) ready.emplace_back(std::move(w->done), events);
+            waiters.erase(end, waiters.end());
+
+            if (waiters.empty()) return; // stays disarmed until the next when_ready
+            try {
+                arm(fd, it->second);
+            } catch (...) {
+                // cannot wait for the rest anymore: wake them with an error
+                for (auto& w : waiters) ready.emplace_back(std::move(w.done), events | io_events::error);
+                waiters.clear();
+            }
+        }
+
+        std::size_t
+        run_posted() {
+            std::uint64_t count;
+            while (::read(_wakeup, &count, sizeof count) > 0) { }
+
+            std::vector<task_type> tasks;
+            {
+                std::scoped_lock lck(_mtx);
+                tasks.swap(_posted);
+            }
+            for (auto& task : tasks) task();
+            return tasks.size();
+        }
+
+        void
+        notify() noexcept {
+            const std::uint64_t one = 1;
+            // only fails if the counter is about to overflow: then it is readable anyway
+            [[maybe_unused]] const auto written = ::write(_wakeup, &one, sizeof one);
+        }
+
+        int _epoll;
+        int _wakeup;
+        std::atomic<bool> _stopped{false};
+
+        std::mutex _mtx;
+        std::unordered_map<int, fd_entry> _fds;
+        std::vector<task_type> _posted;
+    };
+}
+
+#endif
@@ -0,0 +1,519 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+#include <cassert>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <info/_macros.hpp>
+#include <info/cancellation.hpp>
+#include <info/executor.hpp>
+#include <info/expected.hpp>
+#include <info/future.hpp>
+#include <info/static_warning.hpp>
+
+namespace info {
+    namespace impl {
+        /// The shared state of a result_future: a value, an error value of
+        /// type E, or an exception. Errors are stored like values, so failing
+        /// does not allocate an exception object, and nothing is thrown to
+        /// propagate them.
+        template<class T, class E>
+        struct result_state : state_base {
+            using value_type = T;
+            using error_type = E;
+            static_warning(std::is_nothrow_destructible_v<value_type>,
+                           "result_state<T, E>: T has a throwing destructor. "
+                           "This may lead to unexpected termination.");
+
+            template<class... Args>
+            void
+            put_value(Args&&... args) {
+                new (&_value) value_type(std::forward<Args>(args)...);
+                complete(state_status::Completed);
+            }
+            template<class... Args>
+            void
+            put_error(Args&&... args) {
+                new (&_error) error_type(std::forward<Args>(args)...);
+                complete(state_status::Failed);
+            }
+            void
+            put_exception(const std::exception_ptr& ex) {
+                new (&_exc) std::exception_ptr(ex);
+                complete(state_status::Errored);
+            }
+
+            /// Waits for the result, and moves it out of the state. Only
+            /// exceptions are thrown: errors are returned in the expected.
+            expected<value_type, error_type>
+            expect() {
+                wait();
+                // clang-format off
+                if (INFO_UNLIKELY_(completed_status() == state_status::Errored)) INFO_UNLIKELY {
+                    std::rethrow_exception(_exc);
+                }
+                // clang-format on
+                if (completed_status() == state_status::Failed) return info::INFO_UNEXPECTED<error_type>{std::move(_error)};
+                return std::move(_value);
+            }
+
+            result_state() noexcept
+                 : state_base() { }
+
+            ~result_state() noexcept override {
+                switch (completed_status()) {
+                case state_status::InProgress:
+                    return;
+                case state_status::Completed:
+                    _value.~value_type();
+                    return;
+                case state_status::Errored:
+                    _exc.~exception_ptr();
+                    return;
+                case state_status::Failed:
+                    _error.~error_type();
+                    return;
+                }
+                INFO_UNREACHABLE;
+            }
+
+            /// Whether the state completed with an error value. Only to be
+            /// called once the state is complete, like the accessors below.
+            INFO_NODISCARD_JUST
+            bool
+            has_error() const noexcept {
+                return completed_status() == state_status::Failed;
+            }
+
+            INFO_NODISCARD_JUST
+            bool
+            has_exception() const noexcept {
+                return completed_status() == state_status::Errored;
+            }
+
+            /// For the only consumer of the state, to move the value on.
+            INFO_NODISCARD_JUST
+            value_type&&
+            take_value() noexcept {
+                assert(completed_status() == state_status::Completed);
+                return std::move(_value);
+            }
+
+            /// For the only consumer of the state, to move the error on.
+            INFO_NODISCARD_JUST
+            error_type&&
+            take_error() noexcept {
+                assert(completed_status() == state_status::Failed);
+                return std::move(_error);
+            }
+
+            INFO_NODISCARD_JUST
+            const std::exception_ptr&
+            exception() const noexcept {
+                assert(completed_status() == state_status::Errored);
+                return _exc;
+            }
+
+        private:
+            union {
+                value_type _value;
+                error_type _error;
+                std::exception_ptr _exc;
+            };
+        };
+
+        /// The value a result continuation returning R produces: if R is an
+        /// expected with the same error type, its value, otherwise R itself.
+        template<class R, class E>
+        struct result_value {
+            using type = R;
+        };
+        template<class U, class E>
+        struct result_value<expected<U, E>, E> {
+            using type = U;
+        };
+        template<class R, class E>
+        using result_value_t = typename result_value<R, E>::type;
+
+        /// The state of a result_future created by then(). Like chained_state,
+        /// but an error in the previous state skips the continuation, and is
+        /// moved on as it is. A continuation may fail without throwing by
+        /// returning an expected holding the error.
+        template<class Arg, class E, class Fn>
+        struct result_chained_state final : result_state<result_value_t<std::decay_t<std::invoke_result_t<Fn&, Arg&&>>, E>, E>,
+                                      private continuation {
+            using result_type = std::decay_t<std::invoke_result_t<Fn&, Arg&&>>;
+            using value_type = result_value_t<result_type, E>;
+
+            /// Attaches to the previous state. Until the continuation runs,
+            /// the previous state holds a reference to this one.
+            void
+            start() {
+                this->add_ref();
+                _last_step->attach(*this);
+            }
+
+            template<class Fn_>
+            result_chained_state(state_ptr<result_state<Arg, E>>&& last,
+                                 Fn_&& fn,
+                                 executor* exec,
+                                 cancellation_token token)
+                 : result_state<value_type, E>(),
+                   _fn(std::forward<Fn_>(fn)),
+                   _last_step(std::move(last)),
+                   _exec(exec),
+                   _token(std::move(token)) {
+                this->set_token(_token);
+            }
+
+        private:
+            void
+            on_ready() noexcept override {
+                INFO_TRACE_FUTURE_(scheduled, this);
+                if (!_exec) {
+                    run();
+                    this->release();
+                    return;
+                }
+                // the reference held by the previous state is handed to the task
+                _exec->execute([this] {
+                    run();
+                    this->release();
+                });
+            }
+
+            void
+            run() noexcept {
+                INFO_TRACE_FUTURE_(started, this);
+                try {
+                    if (_last_step->has_error()) {
+                        this->put_error(_last_step->take_error());
+                    } else if (_last_step->has_exception()) {
+                        this->put_exception(_last_step->exception());
+                    } else if (this->token().cancelled()) {
+                        this->put_exception(std::make_exception_ptr(operation_cancelled()));
+                    } else if constexpr (std::is_same_v<result_type, value_type>) {
+                        this->put_value(std::invoke(_fn, _last_step->take_value()));
+                    } else {
+                        auto res = std::invoke(_fn, _last_step->take_value());
+                        if (res) {
+                            // expected has no rvalue accessor, but its pointer access moves just as well
+                            this->put_value(std::move(*res.operator->()));
+                        } else {
+                            this->put_error(std::move(res).error());
+                        }
+                    }
+                } catch (...) {
+                    this->put_exception(std::current_exception());
+                }
+                _last_step.reset();
+                INFO_TRACE_FUTURE_(finished, this);
+            }
+
+            Fn _fn;
+            state_ptr<result_state<Arg, E>> _last_step;
+            /// Null if the continuation runs inline.
+            executor* _exec;
+            cancellation_token _token;
+        };
+
+        template<class T, class E>
+        struct result_promise;
+
+        template<class T, class E>
+        struct result_future {
+            using value_type = T;
+            using error_type = E;
+
+            /// The result_future returned by chaining Fn onto this one.
+            template<class Fn>
+            using then_type = result_future<result_value_t<std::decay_t<std::invoke_result_t<std::decay_t<Fn>&, value_type&&>>, E>, E>;
+
+            INFO_NODISCARD_JUST
+            bool
+            valid() const noexcept {
+                return _state != nullptr;
+            }
+
+            INFO_NODISCARD_JUST
+            bool
+            is_ready() const {
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                return _state->is_ready();
+            }
+
+            void
+            wait() {
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                _state->wait();
+            }
+
+            template<class Rep, class Period>
+            bool
+            wait_for(const std::chrono::duration<Rep, Period>& dur) {
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                return _state->wait_for(dur);
+            }
+
+            template<class Clock, class Duration>
+            bool
+            wait_until(const std::chrono::time_point<Clock, Duration>& tp) {
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                return _state->wait_until(tp);
+            }
+
+            /**
+             * \brief Waits for the result, and moves it out of the future,
+             * which becomes invalid.
+             *
+             * An error set through the promise, or returned by a continuation,
+             * is returned in the expected, without throwing. Exceptions, like
+             * a broken promise or one thrown by a continuation, are rethrown.
+             */
+            expected<value_type, error_type>
+            expect() {
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                auto state = std::move(_state);
+                return state->expect();
+            }
+
+            /**
+             * \brief Waits for the value, and moves it out of the future, which
+             * becomes invalid.
+             *
+             * An error is thrown as it is, like by expected::value.
+             */
+            value_type
+            take() {
+                auto res = expect();
+                // throws the error, if there is one
+                return std::move(*res.operator->());
+            }
+
+            /**
+             * \brief Chains a continuation to run on `exec` once this future
+             * completes with a value.
+             *
+             * The continuation receives the value as an rvalue. It may return a
+             * plain value, or an `expected<U, E>` to fail with an error
+             * without throwing. If this future completes with an error, the
+             * continuation is skipped and the error is moved on to the returned
+             * future, with no exception created.
+             */
+            template<class Fn>
+            INFO_NODISCARD("After a then call the new future should be used for "
+                           "all correspondence, the previous one is invalidated")
+            then_type<Fn>
+            then(executor& exec, Fn&& fn) {
+                return chain(&exec, std::forward<Fn>(fn));
+            }
+
+            /**
+             * \brief Chains a continuation to run inline once this future completes.
+             *
+             * \sa info::run_inline
+             */
+            template<class Fn>
+            INFO_NODISCARD("After a then call the new future should be used for "
+                           "all correspondence, the previous one is invalidated")
+            then_type<Fn>
+            then(run_inline_t, Fn&& fn) {
+                return chain(nullptr, std::forward<Fn>(fn));
+            }
+
+            /**
+             * \brief Chains a continuation to run on the default executor once
+             * this future completes, or right away if it already is.
+             */
+            template<class Fn, class = std::enable_if_t<is_continuation_v<Fn>>>
+            INFO_NODISCARD("After a then call the new future should be used for "
+                           "all correspondence, the previous one is invalidated")
+            then_type<Fn>
+            then(Fn&& fn) {
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                return chain(_state->is_ready() ? nullptr : &default_executor(), std::forward<Fn>(fn));
+            }
+
+            result_future() noexcept
+                 : _state(nullptr) { }
+
+            result_future(const result_future& cp) = delete;
+            result_future& operator=(const result_future& cp) = delete;
+
+            result_future(result_future&& mv) noexcept
+                 : _state(std::move(mv._state)) { }
+            result_future&
+            operator=(result_future&& mv) noexcept {
+                if (_state) _state->abandon();
+                _state = std::move(mv._state);
+                return *this;
+            }
+
+            /// If the future is still pending, it is abandoned, like an info::future.
+            ~result_future() noexcept {
+                if (_state) _state->abandon();
+            }
+
+        private:
+            template<class T_, class E_>
+            friend struct result_promise;
+            template<class T_, class E_>
+            friend struct result_future;
+
+            explicit result_future(state_ptr<result_state<T, E>> state) noexcept
+                 : _state(std::move(state)) { }
+
+            template<class Fn>
+            then_type<Fn>
+            chain(executor* exec, Fn&& fn) {
+                if (!valid()) throw std::future_error(std::future_errc::no_state);
+                using next_state = result_chained_state<value_type, E, std::decay_t<Fn>>;
+
+                auto token = _state->token();
+                auto next = state_ptr<next_state>::make(std::move(_state), std::forward<Fn>(fn), exec, std::move(token));
+                next->start();
+                return then_type<Fn>(std::move(next));
+            }
+
+            state_ptr<result_state<T, E>> _state;
+        };
+
+        template<class T, class E>
+        struct result_promise {
+            using value_type = T;
+            using error_type = E;
+            using future_type = result_future<value_type, error_type>;
+
+            future_type
+            get_future() {
+                if (!_state) throw std::future_error(std::future_errc::no_state);
+                if (_ftr_moved) throw std::future_error(std::future_errc::future_already_retrieved);
+                _ftr_moved = true;
+                return future_type(_state);
+            }
+
+            template<class... Args>
+            void
+            set_value(Args&&... args) {
+                check_unset();
+                INFO_TRACE_FUTURE_(set, _state.get());
+                _state->put_value(std::forward<Args>(args)...);
+                _set = true;
+            }
+
+            /// Completes the future with an error value. Continuations chained
+            /// to it are skipped, and the error reaches the end of the chain
+            /// without any exception being thrown.
+            template<class... Args>
+            void
+            set_error(Args&&... args) {
+                check_unset();
+                INFO_TRACE_FUTURE_(set, _state.get());
+                _state->put_error(std::forward<Args>(args)...);
+                _set = true;
+            }
+
+            void
+            set_exception(const std::exception_ptr& exc) {
+                check_unset();
+                INFO_TRACE_FUTURE_(set, _state.get());
+                _state->put_exception(exc);
+                _set = true;
+            }
+
+            /// Whether the result is still wanted, as told by the token the
+            /// promise was created with. Cheap enough to poll.
+            INFO_NODISCARD_JUST
+            bool
+            cancelled() const noexcept {
+                return _state && _state->token().cancelled();
+            }
+
+            result_promise()
+                 : _state(state_ptr<result_state<value_type, error_type>>::make()),
+                   _set(false),
+                   _ftr_moved(false) { }
+
+            /// Creates a promise whose future, and the continuations chained
+            /// to it, observe `token`.
+            explicit result_promise(cancellation_token token)
+                 : _state(state_ptr<cancellable_state<result_state<value_type, error_type>>>::make(std::move(token))),
+                   _set(false),
+                   _ftr_moved(false) { }
+
+            result_promise(const result_promise& cp) = delete;
+            result_promise& operator=(const result_promise& cp) = delete;
+
+            result_promise(result_promise&& mv) noexcept
+                 : _state(std::move(mv._state)),
+                   _set(mv._set),
+                   _ftr_moved(mv._ftr_moved) { }
+            result_promise&
+            operator=(result_promise&& mv) noexcept {
+                result_promise(std::move(mv)).swap(*this);
+                return *this;
+            }
+
+            void
+            swap(result_promise& other) noexcept {
+                _state.swap(other._state);
+                std::swap(_set, other._set);
+                std::swap(_ftr_moved, other._ftr_moved);
+            }
+
+            /// A promise dropped unsatisfied breaks its future with an exception:
+            /// there is no error value to use for it.
+            ~result_promise() noexcept {
+                if (_state && !_set && _ftr_moved)
+                    _state->put_exception(std::make_exception_ptr(
+                           std::future_error(std::future_errc::broken_promise)));
+            }
+
+        private:
+            void
+            check_unset() const {
+                if (!_state) throw std::future_error(std::future_errc::no_state);
+                if (_set) throw std::future_error(std::future_errc::promise_already_satisfied);
+            }
+
+            state_ptr<result_state<value_type, error_type>> _state;
+            bool _set;
+            bool _ftr_moved;
+        };
+    }
+
+    /**
+     * \brief A future whose failures are values of type E, instead of exceptions.
+     *
+     * Errors, set by result_promise::set_error or returned by a continuation
+     * in an expected, travel through the chain like values: continuations
+     * are skipped, and expect() returns the error in an `expected<T, E>`,
+     * without any exception object being allocated or thrown. Suited to
+     * failures common enough for exception handling to show, with E being,
+     * for example, std::error_code or an enum.
+     *
+     * Exceptions still work, for the failures which really are exceptional.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    template<class T, class E>
+    using result_future = impl::result_future<T, E>;
+    /**
+     * \brief The promise of an info::result_future, with set_error.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    template<class T, class E>
+    using result_promise = impl::result_promise<T, E>;
+}
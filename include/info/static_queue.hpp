@@ -0,0 +1,197 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include <info/_macros.hpp>
+
+namespace info {
+    /**
+     * \brief A fixed-capacity, single-threaded FIFO ring with inline storage.
+     *
+     * Never allocates: the elements live inside the object, so it can be
+     * placed on the stack or embedded into other objects. Indices wrap by
+     * masking, hence the capacity must be a power of two. Every operation,
+     * except the bulk ones, is usable in constant expressions.
+     *
+     * Not thread-safe; for sharing elements between threads use info::queue.
+     *
+     * \tparam T The element type. Must be default constructible and move assignable.
+     * \tparam N The capacity. Must be a power of two.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    template<class T, std::size_t N>
+    struct static_queue {
+        using value_type = T;
+        using size_type = std::size_t;
+        static_assert(N != 0 && (N & (N - 1)) == 0,
+                      "static_queue<T, N>: N must be a power of two");
+        static_assert(std::is_default_constructible_v<value_type>,
+                      "static_queue<T, N>: T must be default constructible");
+        static_assert(std::is_move_assignable_v<value_type>,
+                      "static_queue<T, N>: T must be move assignable");
+
+        /**
+         * \brief Constructs an element at the back from `args`.
+         *
+         * \return Whether there was room for the element.
+         */
+        template<class... Args>
+        constexpr bool
+        emplace(Args&&... args) {
+            if (full()) return false;
+            _buf[_tail & mask] = value_type(std::forward<Args>(args)...);
+            ++_tail;
+            return true;
+        }
+
+        constexpr bool
+        push(const value_type& value) {
+            return emplace(value);
+        }
+
+        constexpr bool
+        push(value_type&& value) {
+            return emplace(std::move(value));
+        }
+
+        /**
+         * \brief Removes and returns the front element. The queue must not be empty.
+         */
+        constexpr value_type
+        pop() {
+            assert(!empty() && "static_queue<T, N>::pop(): queue is empty");
+            auto value = std::move(_buf[_head & mask]);
+            ++_head;
+            return value;
+        }
+
+        /**
+         * \brief Moves the front element into `out` if there is one.
+         *
+         * \return Whether an element was popped.
+         */
+        constexpr bool
+        try_pop(value_type& out) {
+            if (empty()) return false;
+            out = std::move(_buf[_head & mask]);
+            ++_head;
+            return true;
+        }
+
+        INFO_NODISCARD_JUST
+        constexpr value_type&
+        front() {
+            assert(!empty() && "static_queue<T, N>::front(): queue is empty");
+            return _buf[_head & mask];
+        }
+
+        INFO_NODISCARD_JUST
+        constexpr const value_type&
+        front() const {
+            assert(!empty() && "static_queue<T, N>::front(): queue is empty");
+            return _buf[_head & mask];
+        }
+
+        /**
+         * \brief Pushes up to `n` elements from `src`, as many as fit.
+         *
+         * Trivially copyable elements are copied with at most two memcpy calls.
+         *
+         * \return The number of elements pushed.
+         */
+        size_type
+        push_n(const value_type* src, size_type n) {
+            n = std::min(n, N - size());
+            const auto pos = _tail & mask;
+            const auto first = std::min(n, N - pos);
+            copy_n(src, first, _buf + pos);
+            copy_n(src + first, n - first, _buf);
+            _tail += n;
+            return n;
+        }
+
+        /**
+         * \brief Pops up to `n` elements into `dst`, as many as there are.
+         *
+         * Trivially copyable elements are copied with at most two memcpy calls.
+         *
+         * \return The number of elements popped.
+         */
+        size_type
+        pop_n(value_type* dst, size_type n) {
+            n = std::min(n, size());
+            const auto pos = _head & mask;
+            const auto first = std::min(n, N - pos);
+            move_n(_buf + pos, first, dst);
+            move_n(_buf, n - first, dst + first);
+            _head += n;
+            return n;
+        }
+
+        constexpr void
+        clear() noexcept {
+            _head = _tail;
+        }
+
+        INFO_NODISCARD_JUST
+        constexpr bool
+        empty() const noexcept {
+            return _head == _tail;
+        }
+
+        INFO_NODISCARD_JUST
+        constexpr bool
+        full() const noexcept {
+            return size() == N;
+        }
+
+        INFO_NODISCARD_JUST
+        constexpr size_type
+        size() const noexcept {
+            return _tail - _head;
+        }
+
+        INFO_NODISCARD_JUST
+        constexpr static size_type
+        capacity() noexcept {
+            return N;
+        }
+
+    private:
+        constexpr const static size_type mask = N - 1;
+
+        static void
+        copy_n(const value_type* src, size_type n, value_type* dst) {
+            if constexpr (std::is_trivially_copyable_v<value_type>) {
+                if (n != 0) std::memcpy(dst, src, n * sizeof(value_type));
+            } else {
+                std::copy_n(src, n, dst);
+            }
+        }
+
+        static void
+        move_n(value_type* src, size_type n, value_type* dst) {
+            if constexpr (std::is_trivially_copyable_v<value_type>) {
+                if (n != 0) std::memcpy(dst, src, n * sizeof(value_type));
+            } else {
+                std::move(src, src + n, dst);
+            }
+        }
+
+        value_type _buf[N]{};
+        // both only ever grow, their difference is the size
+        size_type _head = 0;
+        size_type _tail = 0;
+    };
+}
@@ -0,0 +1,340 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+// Coroutine support for info::future: co_await on futures, and info::task<T>.
+// Only available if the compiler implements C++20 coroutines.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#    define INFO_HAS_COROUTINES 1
+
+#    include <coroutine>
+#    include <exception>
+#    include <optional>
+#    include <type_traits>
+#    include <utility>
+
+#    include <info/_macros.hpp>
+#    include <info/executor.hpp>
+#    include <info/future.hpp>
+
+namespace info {
+    namespace impl {
+        /// Suspends a coroutine until a shared state completes, then resumes
+        /// it in the thread completing the state.
+        template<class T>
+        struct state_awaiter : continuation {
+            bool
+            await_ready() const noexcept {
+                return _state->is_ready();
+            }
+
+            bool
+            await_suspend(std::coroutine_handle<> handle) noexcept {
+                _handle = handle;
+                // completed meanwhile: do not suspend
+                return _state->try_attach(*this);
+            }
+
+            void
+            on_ready() noexcept override {
+                _handle.resume();
+            }
+
+            explicit state_awaiter(state_ptr<future_state<T>> state) noexcept
+                 : _state(std::move(state)) { }
+
+        protected:
+            state_ptr<future_state<T>> _state;
+            std::coroutine_handle<> _handle;
+        };
+
+        template<class T>
+        struct future_awaiter final : state_awaiter<T> {
+            T
+            await_resume() {
+                return this->_state->take();
+            }
+
+            using state_awaiter<T>::state_awaiter;
+        };
+
+        template<class T>
+        struct shared_future_awaiter final : state_awaiter<T> {
+            const T&
+            await_resume() {
+                if (this->_state->has_exception()) std::rethrow_exception(this->_state->exception());
+                return this->_state->value();
+            }
+
+            using state_awaiter<T>::state_awaiter;
+        };
+
+        /// Awaiting a future consumes it, and results in its value.
+        template<class S>
+        future_awaiter<typename S::value_type>
+        operator co_await(future<S>&& ftr) {
+            return future_awaiter<typename S::value_type>(future_access::take_state(ftr));
+        }
+
+        template<class T>
+        shared_future_awaiter<T>
+        operator co_await(const shared_future<T>& ftr) {
+            return shared_future_awaiter<T>(future_access::share_state(ftr));
+        }
+
+        /// Stores the result of a task, or the exception it exited with.
+        template<class T>
+        struct task_result {
+            template<class U>
+            void
+            return_value(U&& value) {
+                _value.emplace(std::forward<U>(value));
+            }
+
+            T
+            result() {
+                if (_exc) std::rethrow_exception(_exc);
+                return std::move(*_value);
+            }
+
+            std::optional<T> _value;
+            std::exception_ptr _exc;
+        };
+
+        template<>
+        struct task_result<void> {
+            void
+            return_void() noexcept { }
+
+            void
+            result() {
+                if (_exc) std::rethrow_exception(_exc);
+            }
+
+            std::exception_ptr _exc;
+        };
+
+        /// A fire-and-forget coroutine, used to drive a task into a promise.
+        struct detached_task {
+            struct promise_type {
+                detached_task
+                get_return_object() noexcept {
+                    return {};
+                }
+
+                std::suspend_never
+                initial_suspend() noexcept {
+                    return {};
+                }
+
+                std::suspend_never
+                final_suspend() noexcept {
+                    return {};
+                }
+
+                void
+                return_void() noexcept { }
+
+                void
+                unhandled_exception() noexcept {
+                    std::terminate();
+                }
+            };
+        };
+    }
+
+    /**
+     * \brief A lazily started coroutine producing a T.
+     *
+     * The coroutine does not run until the task is awaited, or passed to
+     * info::start. Awaiting a task transfers control to it directly, and its
+     * completion transfers control back to the awaiter, so chains of tasks do
+     * not grow the stack. Inside, `co_await` works on info::future,
+     * info::shared_future, other tasks, and info::resume_on.
+     *
+     * Exceptions escaping the coroutine are rethrown to the awaiter.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    template<class T = void>
+    struct task {
+        using value_type = T;
+
+        struct promise_type : impl::task_result<T> {
+            task
+            get_return_object() noexcept {
+                return task(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            std::suspend_always
+            initial_suspend() noexcept {
+                return {};
+            }
+
+            struct final_awaiter {
+                bool
+                await_ready() const noexcept {
+                    return false;
+                }
+
+                std::coroutine_handle<>
+                await_suspend(std::coroutine_handle<promise_type> self) noexcept {
+                    return self.promise()._continuation;
+                }
+
+                void
+                await_resume() const noexcept { }
+            };
+
+            final_awaiter
+            final_suspend() noexcept {
+                return {};
+            }
+
+            void
+            unhandled_exception() noexcept {
+                this->_exc = std::current_exception();
+            }
+
+            /// Who to resume once the task is done.
+            std::coroutine_handle<> _continuation = std::noop_coroutine();
+        };
+
+        bool
+        await_ready() const noexcept {
+            return false;
+        }
+
+        std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<> awaiter) noexcept {
+            _handle.promise()._continuation = awaiter;
+            return _handle;
+        }
+
+        value_type
+        await_resume() {
+            return _handle.promise().result();
+        }
+
+        INFO_NODISCARD_JUST
+        bool
+        valid() const noexcept {
+            return static_cast<bool>(_handle);
+        }
+
+        task(const task& cp) = delete;
+        task& operator=(const task& cp) = delete;
+
+        task(task&& mv) noexcept
+             : _handle(std::exchange(mv._handle, nullptr)) { }
+        task&
+        operator=(task&& mv) noexcept {
+            task(std::move(mv)).swap(*this);
+            return *this;
+        }
+
+        void
+        swap(task& other) noexcept {
+            std::swap(_handle, other._handle);
+        }
+
+        ~task() noexcept {
+            if (_handle) _handle.destroy();
+        }
+
+    private:
+        explicit task(std::coroutine_handle<promise_type> handle) noexcept
+             : _handle(handle) { }
+
+        std::coroutine_handle<promise_type> _handle;
+    };
+
+    /**
+     * \brief Awaitable moving the awaiting coroutine onto `exec`.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    inline auto
+    resume_on(executor& exec) noexcept {
+        struct awaiter {
+            bool
+            await_ready() const noexcept {
+                return false;
+            }
+
+            void
+            await_suspend(std::coroutine_handle<> handle) {
+                _exec.execute([handle] { handle.resume(); });
+            }
+
+            void
+            await_resume() const noexcept { }
+
+            executor& _exec;
+        };
+        return awaiter{exec};
+    }
+
+    namespace impl {
+        template<class T>
+        detached_task
+        drive(task<T> t, promise<T> p) {
+            try {
+                p.set_value(co_await std::move(t));
+            } catch (...) {
+                p.set_exception(std::current_exception());
+            }
+        }
+
+        template<class T>
+        detached_task
+        drive_on(executor& exec, task<T> t, promise<T> p) {
+            try {
+                co_await resume_on(exec);
+                p.set_value(co_await std::move(t));
+            } catch (...) {
+                p.set_exception(std::current_exception());
+            }
+        }
+    }
+
+    /**
+     * \brief Starts a task in the calling thread, and returns a future of its result.
+     *
+     * The task runs until its first suspension before start returns.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    template<class T>
+    future<T>
+    start(task<T> t) {
+        static_assert(!std::is_void_v<T>, "start(): info::future<void> is not supported");
+        promise<T> p;
+        auto ftr = p.get_future();
+        impl::drive(std::move(t), std::move(p));
+        return ftr;
+    }
+
+    /**
+     * \brief Starts a task on `exec`, and returns a future of its result.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    template<class T>
+    future<T>
+    start(executor& exec, task<T> t) {
+        static_assert(!std::is_void_v<T>, "start(): info::future<void> is not supported");
+        promise<T> p;
+        auto ftr = p.get_future();
+        impl::drive_on(exec, std::move(t), std::move(p));
+        return ftr;
+    }
+}
+
+#endif
@@ -0,0 +1,298 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <info/_macros.hpp>
+#include <info/executor.hpp>
+#include <info/future.hpp>
+
+namespace info {
+    /**
+     * \brief Timings of one run of an info::task_graph.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct task_graph_stats {
+        /// The number of nodes run.
+        std::size_t nodes = 0;
+        /// From the call to run() until the last node finished.
+        std::chrono::nanoseconds wall_time{0};
+        /// The longest chain of dependent nodes, by the time the nodes on it
+        /// took to run. No schedule could finish the run faster than this.
+        std::chrono::nanoseconds critical_path{0};
+        /// The time all nodes took to run, added up.
+        std::chrono::nanoseconds busy_time{0};
+    };
+
+    namespace impl {
+        struct graph_node {
+            template<class Fn>
+            graph_node(std::size_t index, Fn&& fn)
+                 : index(index),
+                   fn(std::forward<Fn>(fn)) { }
+
+            const std::size_t index;
+            std::function<void()> fn;
+            std::vector<graph_node*> successors;
+            std::size_t predecessors = 0;
+
+            /// The predecessors yet to finish in the current run.
+            std::atomic<std::size_t> pending{0};
+            /// The longest chain of node run times leading to this node in the
+            /// current run, in nanoseconds. Written by the predecessors.
+            std::atomic<std::int64_t> path{0};
+        };
+
+        inline void
+        atomic_max(std::atomic<std::int64_t>& target, std::int64_t value) noexcept {
+            auto cur = target.load(std::memory_order_relaxed);
+            while (cur < value && !target.compare_exchange_weak(cur, value, std::memory_order_relaxed)) { }
+        }
+    }
+
+    /**
+     * \brief A set of tasks with dependencies between them, run in parallel
+     * as the dependencies allow.
+     *
+     * Nodes are callables added with add(), and precede() makes one node
+     * wait for another. Joins and forks need no thread to block: each node
+     * counts its unfinished predecessors, and the predecessor which brings the
+     * count to zero runs it, or hands it to the executor if it has more than
+     * one successor to start.
+     *
+     * The graph is built once, and can be run any number of times, but not
+     * concurrently with itself. Running it does not allocate, apart from the
+     * future returned, which completes with the timings of the run. If a node
+     * throws, or the executor fails to take a node, the nodes not yet started
+     * are skipped, and the future completes with the exception.
+     *
+     * The graph must not be changed, or destroyed, while it runs.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct task_graph {
+        using node_id = std::size_t;
+        using clock = std::chrono::steady_clock;
+
+        /// Adds a node running `fn`, which takes no arguments. Returns its id.
+        template<class Fn>
+        node_id
+        add(Fn&& fn) {
+            _nodes.emplace_back(_nodes.size(), std::forward<Fn>(fn));
+            _checked = false;
+            return _nodes.size() - 1;
+        }
+
+        /**
+         * \brief Makes `after` wait for `before` to finish.
+         *
+         * \throws std::out_of_range if either id is not a node of this graph.
+         */
+        void
+        precede(node_id before, node_id after) {
+            if (before >= _nodes.size() || after >= _nodes.size())
+                throw std::out_of_range("task_graph::precede: no such node");
+            _nodes[before].successors.push_back(&_nodes[after]);
+            ++_nodes[after].predecessors;
+            _checked = false;
+        }
+
+        INFO_NODISCARD_JUST
+        std::size_t
+        size() const noexcept {
+            return _nodes.size();
+        }
+
+        INFO_NODISCARD_JUST
+        bool
+        running() const noexcept {
+            return _running.load(std::memory_order_acquire);
+        }
+
+        /**
+         * \brief Runs every node on `exec`, each once its predecessors finished.
+         *
+         * \throws std::invalid_argument if the dependencies form a cycle.
+         * \throws std::logic_error if the graph is already running.
+         */
+        future<task_graph_stats>
+        run(executor& exec) {
+            if (_running.exchange(true, std::memory_order_acquire))
+                throw std::logic_error("task_graph::run: the graph is already running");
+            try {
+                check();
+                _done = promise<task_graph_stats>();
+            } catch (...) {
+                _running.store(false, std::memory_order_release);
+                throw;
+            }
+            auto ftr = _done.get_future();
+
+            for (auto& node : _nodes) {
+                node.pending.store(node.predecessors, std::memory_order_relaxed);
+                node.path.store(0, std::memory_order_relaxed);
+            }
+            _remaining.store(_nodes.size(), std::memory_order_relaxed);
+            _critical_path.store(0, std::memory_order_relaxed);
+            _busy_time.store(0, std::memory_order_relaxed);
+            _failed.store(false, std::memory_order_relaxed);
+            _exc = nullptr;
+            _exec = &exec;
+            _start = clock::now();
+
+            if (_nodes.empty()) {
+                finish();
+                return ftr;
+            }
+            // the run cannot finish before the last root is submitted
+            for (auto root : _roots) submit(root);
+            return ftr;
+        }
+
+        /// Runs every node on the default info::work_stealing_pool.
+        future<task_graph_stats>
+        run() {
+            return run(default_work_stealing_pool());
+        }
+
+        task_graph() = default;
+
+        task_graph(const task_graph& cp) = delete;
+        task_graph& operator=(const task_graph& cp) = delete;
+
+    private:
+        using node = impl::graph_node;
+
+        /// Finds the roots, and checks that every node is reachable from them.
+        /// Only done after the graph changed.
+        void
+        check() {
+            if (_checked) return;
+
+            std::vector<std::size_t> waiting;
+            waiting.reserve(_nodes.size());
+            std::vector<node*> ready;
+            for (auto& n : _nodes) {
+                waiting.push_back(n.predecessors);
+                if (n.predecessors == 0) ready.push_back(&n);
+            }
+            auto roots = ready;
+
+            std::size_t visited = 0;
+            while (!ready.empty()) {
+                auto n = ready.back();
+                ready.pop_back();
+                ++visited;
+                for (auto s : n->successors) {
+                    if (--waiting[s->index] == 0) ready.push_back(s);
+                }
+            }
+            if (visited != _nodes.size()) throw std::invalid_argument("task_graph::run: the dependencies form a cycle");
+
+            _roots = std::move(roots);
+            _checked = true;
+        }
+
+        /// Hands `n` to the executor. If that throws, the run fails, and `n`
+        /// is run here instead, which skips it and the nodes after it, so the
+        /// run still finishes.
+        void
+        submit(node* n) noexcept {
+            try {
+                _exec->execute([this, n] { run_from(n); });
+            } catch (...) {
+                fail(std::current_exception());
+                run_from(n);
+            }
+        }
+
+        /// Runs `n`, then one of the successors it makes ready, and so on,
+        /// handing the other ready successors to the executor.
+        void
+        run_from(node* n) noexcept {
+            while (n) {
+                const auto begin = clock::now();
+                if (!_failed.load(std::memory_order_relaxed)) {
+                    try {
+                        n->fn();
+                    } catch (...) {
+                        fail(std::current_exception());
+                    }
+                }
+                const auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - begin).count();
+                _busy_time.fetch_add(took, std::memory_order_relaxed);
+
+                const auto path = n->path.load(std::memory_order_relaxed) + took;
+                if (n->successors.empty()) impl::atomic_max(_critical_path, path);
+
+                node* next = nullptr;
+                for (auto s : n->successors) {
+                    impl::atomic_max(s->path, path);
+                    // the last predecessor to finish sees the others' paths
+                    if (s->pending.fetch_sub(1, std::memory_order_acq_rel) != 1) continue;
+                    if (next) submit(next);
+                    next = s;
+                }
+
+                if (_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) finish();
+                n = next;
+            }
+        }
+
+        void
+        fail(std::exception_ptr exc) noexcept {
+            if (!_failed.exchange(true, std::memory_order_relaxed)) _exc = std::move(exc);
+        }
+
+        /// Completes the future of the run. The graph may be run again, or
+        /// destroyed, by the continuations of the future, so nothing is
+        /// touched after it is completed.
+        void
+        finish() noexcept {
+            task_graph_stats stats;
+            stats.nodes = _nodes.size();
+            stats.wall_time = clock::now() - _start;
+            stats.critical_path = std::chrono::nanoseconds(_critical_path.load(std::memory_order_relaxed));
+            stats.busy_time = std::chrono::nanoseconds(_busy_time.load(std::memory_order_relaxed));
+
+            auto done = std::move(_done);
+            auto exc = std::move(_exc);
+            _running.store(false, std::memory_order_release);
+            if (exc) {
+                done.set_exception(exc);
+            } else {
+                done.set_value(stats);
+            }
+        }
+
+        /// Stable addresses, so successors can point at the nodes.
+        std::deque<node> _nodes;
+        std::vector<node*> _roots;
+        bool _checked = true;
+
+        std::atomic<bool> _running{false};
+        promise<task_graph_stats> _done;
+        executor* _exec = nullptr;
+        clock::time_point _start;
+        std::atomic<std::size_t> _remaining{0};
+        std::atomic<std::int64_t> _critical_path{0};
+        std::atomic<std::int64_t> _busy_time{0};
+        std::atomic<bool> _failed{false};
+        std::exception_ptr _exc;
+    };
+}
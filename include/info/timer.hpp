@@ -0,0 +1,579 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <info/_macros.hpp>
+#include <info/future.hpp>
+
+namespace info {
+    struct timer_service;
+
+    /**
+     * \brief Stored in futures which did not complete before their deadline.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct deadline_exceeded final : std::exception {
+        const char*
+        what() const noexcept override {
+            return "deadline exceeded";
+        }
+    };
+
+    namespace impl {
+        /// Something a timer_service runs at a point in time. Intrusive: the
+        /// wheel links nodes together, so scheduling does not allocate.
+        struct timer_node {
+            /// Called exactly once by the service: `expired` is true if the
+            /// timer expired, false if it was cancelled, or the service was
+            /// destroyed first. The service does not touch the node afterwards.
+            virtual void
+            fire(bool expired) noexcept = 0;
+
+            /// Prevents the timer from expiring, if it has not yet.
+            /// Returns whether this call cancelled it.
+            bool
+            cancel() noexcept {
+                auto expected = pending;
+                return _state.compare_exchange_strong(expected, cancelled, std::memory_order_acq_rel);
+            }
+
+        protected:
+            virtual ~timer_node() noexcept = default;
+
+        private:
+            friend struct info::timer_service;
+
+            /// Claims the node for expiry. False if it was cancelled.
+            bool
+            claim() noexcept {
+                auto expected = pending;
+                return _state.compare_exchange_strong(expected, expired, std::memory_order_acq_rel);
+            }
+
+            constexpr const static std::uint8_t pending = 0;
+            constexpr const static std::uint8_t expired = 1;
+            constexpr const static std::uint8_t cancelled = 2;
+
+            std::atomic<std::uint8_t> _state{pending};
+            /// The tick the timer expires at, in the service's ticks.
+            std::int64_t _tick = 0;
+            /// The next node in the intake stack or in the wheel slot.
+            timer_node* _next = nullptr;
+        };
+
+        template<class Fn>
+        struct callback_timer final : timer_node {
+            void
+            fire(bool expired) noexcept override {
+                if (expired) _fn();
+                release();
+            }
+
+            void
+            add_ref() noexcept {
+                _refs.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void
+            release() noexcept {
+                if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+            }
+
+            template<class Fn_>
+            explicit callback_timer(Fn_&& fn)
+                 : _fn(std::forward<Fn_>(fn)) { }
+
+        private:
+            Fn _fn;
+            std::atomic<unsigned> _refs{0};
+        };
+    }
+
+    /**
+     * \brief A handle to a scheduled callback, through which it can be cancelled.
+     *
+     * Dropping the handle does not cancel the timer.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct timer_handle {
+        /// Cancels the timer, unless it already expired.
+        /// Returns whether the callback was prevented from running.
+        bool
+        cancel() noexcept {
+            return _cancel && _cancel(_node);
+        }
+
+        timer_handle() noexcept = default;
+
+        timer_handle(const timer_handle& cp) = delete;
+        timer_handle& operator=(const timer_handle& cp) = delete;
+
+        timer_handle(timer_handle&& mv) noexcept
+             : _node(std::exchange(mv._node, nullptr)),
+               _cancel(std::exchange(mv._cancel, nullptr)),
+               _release(std::exchange(mv._release, nullptr)) { }
+        timer_handle&
+        operator=(timer_handle&& mv) noexcept {
+            timer_handle(std::move(mv)).swap(*this);
+            return *this;
+        }
+
+        void
+        swap(timer_handle& other) noexcept {
+            std::swap(_node, other._node);
+            std::swap(_cancel, other._cancel);
+            std::swap(_release, other._release);
+        }
+
+        ~timer_handle() noexcept {
+            if (_release) _release(_node);
+        }
+
+    private:
+        friend struct timer_service;
+
+        template<class Fn>
+        explicit timer_handle(impl::callback_timer<Fn>* node) noexcept
+             : _node(node),
+               _cancel([](void* n) noexcept { return static_cast<impl::callback_timer<Fn>*>(n)->cancel(); }),
+               _release([](void* n) noexcept { static_cast<impl::callback_timer<Fn>*>(n)->release(); }) {
+            node->add_ref();
+        }
+
+        void* _node = nullptr;
+        bool (*_cancel)(void*) noexcept = nullptr;
+        void (*_release)(void*) noexcept = nullptr;
+    };
+
+    /**
+     * \brief Runs timers on a single thread, driving a hierarchical timing wheel.
+     *
+     * The wheel has four levels of 64 slots. The first level holds timers
+     * expiring within 64 ticks of 1ms, one slot per tick. Each further level
+     * covers 64 times the span of the previous one, and its slots are
+     * redistributed to the level below once the wheel reaches them. Inserting
+     * and cancelling a timer are O(1), as is expiring it, up to the three
+     * redistributions it may take part in. Timers further out than the
+     * wheel's span of about 4.6 hours are parked in the last level and
+     * redistributed until they are due.
+     *
+     * Timers are scheduled from any thread through a lock-free stack, which
+     * the service thread drains; the thread is only woken if the new timer
+     * expires before it would wake anyway. Cancelled timers are dropped
+     * lazily, when their slot comes up.
+     *
+     * Timers never fire early, and fire at most about one tick late, plus
+     * scheduling latency. Callbacks run on the service thread, so they should
+     * be short.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    struct timer_service {
+        using clock = std::chrono::steady_clock;
+        using tick_duration = std::chrono::milliseconds;
+
+        /**
+         * \brief Runs `fn` on the service thread at `tp`.
+         */
+        template<class Fn>
+        timer_handle
+        schedule_at(clock::time_point tp, Fn&& fn) {
+            auto node = new impl::callback_timer<std::decay_t<Fn>>(std::forward<Fn>(fn));
+            timer_handle handle(node);
+            node->add_ref(); // held by the wheel until it fires
+            schedule(*node, tp);
+            return handle;
+        }
+
+        /**
+         * \brief Runs `fn` on the service thread after `dur`.
+         */
+        template<class Rep, class Period, class Fn>
+        timer_handle
+        schedule_after(const std::chrono::duration<Rep, Period>& dur, Fn&& fn) {
+            return schedule_at(clock::now() + std::chrono::duration_cast<clock::duration>(dur),
+                               std::forward<Fn>(fn));
+        }
+
+        /**
+         * \brief Schedules an intrusive timer node to fire at `tp`.
+         *
+         * The node must stay alive until its fire function is called.
+         */
+        void
+        schedule(impl::timer_node& node, clock::time_point tp) noexcept {
+            node._tick = to_tick(tp);
+            auto head = _intake.load(std::memory_order_relaxed);
+            do {
+                node._next = head;
+            } while (!_intake.compare_exchange_weak(head, &node, std::memory_order_seq_cst, std::memory_order_relaxed));
+
+            if (node._tick < _wake_tick.load(std::memory_order_seq_cst)) {
+                { std::scoped_lock lck(_mtx); }
+                _cv.notify_one();
+            }
+        }
+
+        /**
+         * \brief The number of timers in the wheel, including cancelled ones
+         * not yet dropped. Approximate while timers are being scheduled.
+         */
+        INFO_NODISCARD_JUST
+        std::size_t
+        pending() const noexcept {
+            return _count.load(std::memory_order_relaxed);
+        }
+
+        timer_service()
+             : _epoch(clock::now()),
+               _thread([this] { run(); }) { }
+
+        timer_service(const timer_service& cp) = delete;
+        timer_service& operator=(const timer_service& cp) = delete;
+
+        /// Stops the thread. Timers not yet expired are dropped, as if cancelled.
+        ~timer_service() noexcept {
+            {
+                std::scoped_lock lck(_mtx);
+                _stop = true;
+            }
+            _cv.notify_one();
+            _thread.join();
+
+            drop_list(_intake.exchange(nullptr));
+            for (auto& level : _wheel) {
+                for (auto& slot : level) drop_list(std::exchange(slot, nullptr));
+            }
+        }
+
+    private:
+        constexpr const static std::size_t levels = 4;
+        constexpr const static std::size_t slot_bits = 6;
+        constexpr const static std::size_t slots = std::size_t{1} << slot_bits;
+        constexpr const static std::int64_t slot_mask = slots - 1;
+        constexpr const static std::int64_t no_wake = std::numeric_limits<std::int64_t>::max();
+
+        /// The first tick at or after `tp`, so timers never fire early.
+        std::int64_t
+        to_tick(clock::time_point tp) const noexcept {
+            const auto since = tp - _epoch;
+            const auto ticks = std::chrono::duration_cast<tick_duration>(since);
+            return ticks.count() + (ticks < since ? 1 : 0);
+        }
+
+        /// The last tick which began at or before `tp`: the service may
+        /// process it without firing early.
+        std::int64_t
+        last_tick(clock::time_point tp) const noexcept {
+            const auto ticks = std::chrono::floor<tick_duration>(tp - _epoch);
+            return ticks.count();
+        }
+
+        clock::time_point
+        from_tick(std::int64_t tick) const noexcept {
+            return _epoch + tick_duration(tick);
+        }
+
+        static std::int64_t
+        slot_of(std::int64_t tick, std::size_t level) noexcept {
+            return (tick >> (level * slot_bits)) & slot_mask;
+        }
+
+        /// Service thread only.
+        void
+        insert(impl::timer_node* node) noexcept {
+            const auto delta = node->_tick - _now;
+            if (delta <= 0) {
+                fire(node);
+                return;
+            }
+
+            for (std::size_t level = 0; level < levels - 1; ++level) {
+                if (delta < (std::int64_t{1} << ((level + 1) * slot_bits))) {
+                    push(_wheel[level][static_cast<std::size_t>(slot_of(node->_tick, level))], node);
+                    return;
+                }
+            }
+            // the last level, possibly parked for longer than the wheel's span
+            const auto max_delta = (std::int64_t{1} << (levels * slot_bits)) - 1;
+            const auto tick = _now + std::min(delta, max_delta);
+            push(_wheel[levels - 1][static_cast<std::size_t>(slot_of(tick, levels - 1))], node);
+        }
+
+        void
+        push(impl::timer_node*& slot, impl::timer_node* node) noexcept {
+            node->_next = slot;
+            slot = node;
+        }
+
+        void
+        fire(impl::timer_node* node) noexcept {
+            _count.fetch_sub(1, std::memory_order_relaxed);
+            node->fire(node->claim());
+        }
+
+        static void
+        drop_list(impl::timer_node* node) noexcept {
+            while (node) {
+                auto next = node->_next;
+                node->fire(false);
+                node = next;
+            }
+        }
+
+        /// Reinserts the timers of a slot, which end up on lower levels.
+        void
+        cascade(std::size_t level, std::int64_t idx) noexcept {
+            auto node = std::exchange(_wheel[level][static_cast<std::size_t>(idx)], nullptr);
+            while (node) {
+                auto next = node->_next;
+                insert(node);
+                node = next;
+            }
+        }
+
+        void
+        advance() noexcept {
+            ++_now;
+            for (std::size_t level = 1; level < levels; ++level) {
+                if (slot_of(_now, level - 1) != 0) break;
+                cascade(level, slot_of(_now, level));
+            }
+
+            auto node = std::exchange(_wheel[0][static_cast<std::size_t>(slot_of(_now, 0))], nullptr);
+            while (node) {
+                auto next = node->_next;
+                fire(node);
+                node = next;
+            }
+        }
+
+        void
+        drain_intake() noexcept {
+            auto node = _intake.exchange(nullptr, std::memory_order_acquire);
+            while (node) {
+                auto next = node->_next;
+                _count.fetch_add(1, std::memory_order_relaxed);
+                insert(node);
+                node = next;
+            }
+        }
+
+        /// The tick at which the thread has to wake next: the first occupied
+        /// slot of the first level, or the next redistribution.
+        std::int64_t
+        next_wake() const noexcept {
+            if (_count.load(std::memory_order_relaxed) == 0) return no_wake;
+            for (std::int64_t tick = _now + 1;; ++tick) {
+                if (_wheel[0][static_cast<std::size_t>(slot_of(tick, 0))]) return tick;
+                if (slot_of(tick, 0) == 0) return tick;
+            }
+        }
+
+        void
+        run() noexcept {
+            std::unique_lock<std::mutex> lck(_mtx);
+            while (!_stop) {
+                lck.unlock();
+                drain_intake();
+                const auto target = last_tick(clock::now());
+                while (_now < target) advance();
+                lck.lock();
+
+                const auto wake = next_wake();
+                _wake_tick.store(wake, std::memory_order_seq_cst);
+                const auto ready = [this] {
+                    return _stop || _intake.load(std::memory_order_seq_cst) != nullptr;
+                };
+                if (wake == no_wake) {
+                    _cv.wait(lck, ready);
+                } else {
+                    _cv.wait_until(lck, from_tick(wake), ready);
+                }
+            }
+        }
+
+        const clock::time_point _epoch;
+        /// The last tick processed. Service thread only.
+        std::int64_t _now = 0;
+        std::array<std::array<impl::timer_node*, slots>, levels> _wheel{};
+        std::atomic<impl::timer_node*> _intake{nullptr};
+        std::atomic<std::size_t> _count{0};
+        /// The tick the service thread sleeps until.
+        std::atomic<std::int64_t> _wake_tick{0};
+
+        std::mutex _mtx;
+        std::condition_variable _cv;
+        bool _stop = false;
+        std::thread _thread;
+    };
+
+    /**
+     * \brief The process-wide timer_service.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    inline timer_service&
+    default_timer_service() {
+        static timer_service service;
+        return service;
+    }
+
+    namespace impl {
+        /// The timer of a deadline_state. Kept apart from the state, so a
+        /// state completed in time is freed right away, and only this node
+        /// stays in the wheel until its slot comes up.
+        template<class T>
+        struct deadline_timer final : timer_node {
+            void
+            fire(bool expired) noexcept override {
+                if (expired) {
+                    if (auto target = claim_target()) {
+                        target->put_exception(std::make_exception_ptr(deadline_exceeded()));
+                        target->release();
+                    }
+                }
+                release();
+            }
+
+            /// Takes the state, with the reference held on it, unless the
+            /// timer or the input took it first.
+            future_state<T>*
+            claim_target() noexcept {
+                return _target.exchange(nullptr, std::memory_order_acq_rel);
+            }
+
+            void
+            add_ref() noexcept {
+                _refs.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void
+            release() noexcept {
+                if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+            }
+
+            explicit deadline_timer(future_state<T>& target) noexcept
+                 : _target(&target) { }
+
+        private:
+            std::atomic<future_state<T>*> _target;
+            std::atomic<unsigned> _refs{0};
+        };
+
+        /// Races a future against a timer: whichever claims the state first completes it.
+        template<class T>
+        struct deadline_state final : future_state<T>, private continuation {
+            /// Attaches to the input and to the timer, each holding a reference.
+            void
+            start(timer_service& timers, timer_service::clock::time_point tp) {
+                _timer = new deadline_timer<T>(*this);
+                _timer->add_ref(); // held by the wheel until it fires
+                _timer->add_ref(); // held by this state until the input completes
+                this->add_ref();
+                this->add_ref();
+                timers.schedule(*_timer, tp);
+                _input->attach(static_cast<continuation&>(*this));
+            }
+
+            explicit deadline_state(state_ptr<future_state<T>> input)
+                 : future_state<T>(),
+                   _input(std::move(input)),
+                   _token(_input->token()) {
+                this->set_token(_token);
+            }
+
+            ~deadline_state() noexcept override {
+                if (_timer) _timer->release();
+            }
+
+        private:
+            void
+            on_ready() noexcept override {
+                const bool claimed = _timer->claim_target() != nullptr;
+                if (claimed) {
+                    _timer->cancel();
+                    if (_input->has_exception()) {
+                        this->put_exception(_input->exception());
+                    } else {
+                        try {
+                            this->put_value(_input->take_value());
+                        } catch (...) {
+                            this->put_exception(std::current_exception());
+                        }
+                    }
+                }
+                std::exchange(_timer, nullptr)->release();
+                _input.reset();
+                // the reference the timer held, then the input's
+                if (claimed) this->release();
+                this->release();
+            }
+
+            state_ptr<future_state<T>> _input;
+            deadline_timer<T>* _timer = nullptr;
+            cancellation_token _token;
+        };
+    }
+
+    /**
+     * \brief Returns a future completing with the value of `ftr`, or with
+     * info::deadline_exceeded if `ftr` does not complete until `tp`.
+     *
+     * Nothing blocks: the input future and a timer on `timers` race to
+     * complete the returned future. The input future is consumed.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    template<class S, class Clock, class Duration>
+    future<typename S::value_type>
+    with_deadline(impl::future<S>&& ftr,
+                  const std::chrono::time_point<Clock, Duration>& tp,
+                  timer_service& timers = default_timer_service()) {
+        using value_type = typename S::value_type;
+        using state = impl::deadline_state<value_type>;
+
+        const auto deadline = timer_service::clock::now()
+                              + std::chrono::duration_cast<timer_service::clock::duration>(tp - Clock::now());
+        auto st = impl::state_ptr<state>::make(impl::future_access::take_state(ftr));
+        st->start(timers, deadline);
+        return impl::future_access::make_future(impl::state_ptr<impl::future_state<value_type>>(std::move(st)));
+    }
+
+    /**
+     * \brief Returns a future completing with the value of `ftr`, or with
+     * info::deadline_exceeded if `ftr` does not complete within `dur`.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    template<class S, class Rep, class Period>
+    future<typename S::value_type>
+    with_timeout(impl::future<S>&& ftr,
+                 const std::chrono::duration<Rep, Period>& dur,
+                 timer_service& timers = default_timer_service()) {
+        return with_deadline(std::move(ftr), timer_service::clock::now() + dur, timers);
+    }
+}
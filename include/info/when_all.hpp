@@ -0,0 +1,221 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <info/future.hpp>
+
+namespace info {
+    namespace impl {
+        /// A continuation attached to one input of a combinator, reporting
+        /// its completion to the combinator's state.
+        template<class Owner>
+        struct combinator_slot final : continuation {
+            void
+            on_ready() noexcept override {
+                _owner->arrive(_index);
+            }
+
+            Owner* _owner = nullptr;
+            std::size_t _index = 0;
+        };
+
+        /// Shared by the combinator states: attaches a slot to each input,
+        /// and keeps the combinator alive until every slot has fired.
+        template<class Derived, class T>
+        struct combinator_state : future_state<T> {
+        protected:
+            /// Each slot holds a reference to the state, released when it fires.
+            template<class S>
+            void
+            attach_slot(combinator_slot<Derived>& slot, S& input, std::size_t idx) {
+                slot._owner = static_cast<Derived*>(this);
+                slot._index = idx;
+                this->add_ref();
+                input.attach(slot);
+            }
+
+            void
+            slot_done() noexcept {
+                this->release();
+            }
+        };
+
+        template<class... S>
+        struct when_all_state final
+             : combinator_state<when_all_state<S...>, std::tuple<typename S::value_type...>> {
+            using value_type = std::tuple<typename S::value_type...>;
+
+            void
+            arrive(std::size_t) noexcept {
+                if (_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) finish();
+                this->slot_done();
+            }
+
+            explicit when_all_state(state_ptr<S>... inputs)
+                 : _inputs(std::move(inputs)...),
+                   _remaining(sizeof...(S)) { }
+
+            void
+            start() {
+                start(std::index_sequence_for<S...>{});
+            }
+
+        private:
+            template<std::size_t... Is>
+            void
+            start(std::index_sequence<Is...>) {
+                (this->attach_slot(_slots[Is], *std::get<Is>(_inputs), Is), ...);
+            }
+
+            void
+            finish() noexcept {
+                finish(std::index_sequence_for<S...>{});
+            }
+
+            template<std::size_t... Is>
+            void
+            finish(std::index_sequence<Is...>) noexcept {
+                // the first input to fail, in argument order, decides the error
+                std::exception_ptr exc;
+                auto check = [&exc](auto& in) {
+                    if (!exc && in->has_exception()) exc = in->exception();
+                };
+                (check(std::get<Is>(_inputs)), ...);
+                if (exc) {
+                    this->put_exception(exc);
+                } else {
+                    try {
+                        this->put_value(std::get<Is>(_inputs)->take_value()...);
+                    } catch (...) {
+                        this->put_exception(std::current_exception());
+                    }
+                }
+                std::apply([](auto&... in) { (in.reset(), ...); }, _inputs);
+            }
+
+            std::tuple<state_ptr<S>...> _inputs;
+            combinator_slot<when_all_state> _slots[sizeof...(S)];
+            std::atomic<std::size_t> _remaining;
+        };
+
+        template<class S>
+        struct when_all_range_state final
+             : combinator_state<when_all_range_state<S>, std::vector<typename S::value_type>> {
+            using value_type = std::vector<typename S::value_type>;
+
+            void
+            arrive(std::size_t) noexcept {
+                if (_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) finish();
+                this->slot_done();
+            }
+
+            explicit when_all_range_state(std::vector<state_ptr<S>> inputs)
+                 : _inputs(std::move(inputs)),
+                   _slots(_inputs.size()),
+                   _remaining(_inputs.size()) { }
+
+            void
+            start() {
+                if (_inputs.empty()) {
+                    this->put_value();
+                    return;
+                }
+                for (std::size_t i = 0; i < _inputs.size(); ++i) {
+                    this->attach_slot(_slots[i], *_inputs[i], i);
+                }
+            }
+
+        private:
+            void
+            finish() noexcept {
+                for (auto& in : _inputs) {
+                    if (in->has_exception()) {
+                        this->put_exception(in->exception());
+                        _inputs.clear();
+                        return;
+                    }
+                }
+                try {
+                    value_type values;
+                    values.reserve(_inputs.size());
+                    for (auto& in : _inputs) values.push_back(in->take_value());
+                    this->put_value(std::move(values));
+                } catch (...) {
+                    this->put_exception(std::current_exception());
+                }
+                _inputs.clear();
+            }
+
+            std::vector<state_ptr<S>> _inputs;
+            std::vector<combinator_slot<when_all_range_state>> _slots;
+            std::atomic<std::size_t> _remaining;
+        };
+    }
+
+    /**
+     * \brief Combines futures into a future of all their values.
+     *
+     * The returned future completes once every input did, without any extra
+     * threads: the inputs count down a shared counter as they complete, and
+     * the last one collects the values into the tuple. If any input fails,
+     * the result fails with the exception of the first failing input, in
+     * argument order.
+     *
+     * The input futures are consumed.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    template<class... S>
+    future<std::tuple<typename S::value_type...>>
+    when_all(impl::future<S>&&... futures) {
+        static_assert(sizeof...(S) != 0, "when_all(): at least one future is required");
+        using state = impl::when_all_state<S...>;
+
+        auto st = impl::state_ptr<state>::make(impl::future_access::take_state(futures)...);
+        st->start();
+        return impl::future_access::make_future(
+               impl::state_ptr<impl::future_state<typename state::value_type>>(std::move(st)));
+    }
+
+    /**
+     * \brief Combines a range of futures into a future of the vector of their values.
+     *
+     * Same as the variadic version, but the values are stored in the order
+     * of the futures in the range. An empty range results in an already
+     * completed future of an empty vector.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    template<class It>
+    future<std::vector<typename std::iterator_traits<It>::value_type::value_type>>
+    when_all(It begin, It end) {
+        using fut_state = impl::state_of_t<typename std::iterator_traits<It>::value_type>;
+        using state = impl::when_all_range_state<fut_state>;
+
+        std::vector<impl::state_ptr<fut_state>> inputs;
+        inputs.reserve(static_cast<std::size_t>(std::distance(begin, end)));
+        for (; begin != end; ++begin) inputs.push_back(impl::future_access::take_state(*begin));
+
+        auto st = impl::state_ptr<state>::make(std::move(inputs));
+        st->start();
+        return impl::future_access::make_future(
+               impl::state_ptr<impl::future_state<typename state::value_type>>(std::move(st)));
+    }
+
+    template<class Range>
+    auto
+    when_all(Range&& range) -> decltype(when_all(std::begin(range), std::end(range))) {
+        return when_all(std::begin(range), std::end(range));
+    }
+}
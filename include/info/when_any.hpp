@@ -0,0 +1,139 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <info/future.hpp>
+#include <info/when_all.hpp>
+
+namespace info {
+    /**
+     * \brief The result of when_any: which future completed first, and its value.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    template<class T>
+    struct when_any_result {
+        /// The position of the future among the arguments or in the range.
+        std::size_t index;
+        T value;
+    };
+
+    namespace impl {
+        template<class T>
+        struct when_any_state final
+             : combinator_state<when_any_state<T>, when_any_result<T>> {
+            using value_type = when_any_result<T>;
+
+            void
+            arrive(std::size_t idx) noexcept {
+                if (!_done.exchange(true, std::memory_order_acq_rel)) {
+                    auto& in = *_inputs[idx];
+                    if (in.has_exception()) {
+                        this->put_exception(in.exception());
+                    } else {
+                        try {
+                            this->put_value(value_type{idx, in.take_value()});
+                        } catch (...) {
+                            this->put_exception(std::current_exception());
+                        }
+                    }
+                }
+                this->slot_done();
+            }
+
+            explicit when_any_state(std::vector<state_ptr<future_state<T>>> inputs)
+                 : _inputs(std::move(inputs)),
+                   _slots(_inputs.size()),
+                   _done(false) { }
+
+            void
+            start() {
+                for (std::size_t i = 0; i < _inputs.size(); ++i) {
+                    this->attach_slot(_slots[i], *_inputs[i], i);
+                }
+            }
+
+        private:
+            // inputs completing after the first one still fire their slots,
+            // so they are kept until the state is destroyed
+            std::vector<state_ptr<future_state<T>>> _inputs;
+            std::vector<combinator_slot<when_any_state>> _slots;
+            std::atomic<bool> _done;
+        };
+
+        template<class T>
+        future<future_state<when_any_result<T>>>
+        make_when_any(std::vector<state_ptr<future_state<T>>> inputs) {
+            if (inputs.empty()) throw std::invalid_argument("when_any(): at least one future is required");
+            using state = when_any_state<T>;
+
+            auto st = state_ptr<state>::make(std::move(inputs));
+            st->start();
+            return future_access::make_future(
+                   state_ptr<future_state<when_any_result<T>>>(std::move(st)));
+        }
+    }
+
+    /**
+     * \brief Combines futures into a future of the first one to complete.
+     *
+     * The returned future completes as soon as any of the inputs does, with
+     * its position and value, or, if it failed, with its exception. No extra
+     * threads are involved: the first input to complete claims the result
+     * through an atomic flag. The futures must all be of the same value type.
+     *
+     * The input futures are consumed.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    template<class S, class... Ss>
+    future<when_any_result<typename S::value_type>>
+    when_any(impl::future<S>&& first, impl::future<Ss>&&... rest) {
+        using value_type = typename S::value_type;
+        static_assert((std::is_same_v<value_type, typename Ss::value_type> && ...),
+                      "when_any(): all futures must have the same value type");
+
+        std::vector<impl::state_ptr<impl::future_state<value_type>>> inputs;
+        inputs.reserve(1 + sizeof...(Ss));
+        inputs.emplace_back(impl::future_access::take_state(first));
+        (inputs.emplace_back(impl::future_access::take_state(rest)), ...);
+        return impl::make_when_any(std::move(inputs));
+    }
+
+    /**
+     * \brief Combines a range of futures into a future of the first one to complete.
+     *
+     * Same as the variadic version. Throws std::invalid_argument for an empty range.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    template<class It>
+    future<when_any_result<typename std::iterator_traits<It>::value_type::value_type>>
+    when_any(It begin, It end) {
+        using value_type = typename std::iterator_traits<It>::value_type::value_type;
+
+        std::vector<impl::state_ptr<impl::future_state<value_type>>> inputs;
+        inputs.reserve(static_cast<std::size_t>(std::distance(begin, end)));
+        for (; begin != end; ++begin) inputs.emplace_back(impl::future_access::take_state(*begin));
+        return impl::make_when_any(std::move(inputs));
+    }
+
+    template<class Range>
+    auto
+    when_any(Range&& range) -> decltype(when_any(std::begin(range), std::end(range))) {
+        return when_any(std::begin(range), std::end(range));
+    }
+}
@@ -0,0 +1,217 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+
+#include <info/_macros.hpp>
+#include <info/queue.hpp>
+
+namespace info {
+    struct worker_group_options {
+        /// The number of workers kept alive even when idle. At least 1.
+        std::size_t min_workers = 1;
+        /// The maximum number of workers running at once.
+        std::size_t max_workers = std::max(1U, std::thread::hardware_concurrency());
+        /// How long a worker may wait for an element before it retires.
+        std::chrono::milliseconds idle_timeout{1000};
+        /// The queue depth above which a new worker is started, if no workers are idle.
+        std::size_t scale_up_depth = 1;
+        /// How long the oldest element may wait, with no workers idle, before a new worker is started.
+        std::chrono::milliseconds scale_up_wait{10};
+    };
+
+    /**
+     * \brief An elastic group of threads consuming an info::queue.
+     *
+     * Each worker pops elements from the queue and passes them to the handler.
+     * When no worker is waiting for work, and either more than
+     * `scale_up_depth` elements are queued, or the oldest one has waited
+     * `scale_up_wait`, the group starts a new worker, up to `max_workers`.
+     * Workers check the depth whenever they pop an element; a supervising
+     * thread checks both every half `scale_up_wait`, so the group also grows
+     * when every worker is stuck in a long handler. A worker which waits for
+     * work longer than `idle_timeout` retires, unless only `min_workers` are
+     * left.
+     *
+     * If the handler throws, std::terminate is called, just like with std::thread.
+     *
+     * \since 1.9
+     * \author bodand
+     */
+    template<class T, class Lock = std::mutex>
+    struct worker_group {
+        using value_type = T;
+        using queue_type = queue<value_type, Lock>;
+        using handler_type = std::function<void(value_type&)>;
+
+        /**
+         * \brief Ends the queue, then waits until the workers have processed
+         * every element left in it.
+         */
+        void
+        end() {
+            _queue.end();
+
+            std::list<std::thread> threads;
+            {
+                std::scoped_lock lck(_mtx);
+                _ending = true;
+                threads.swap(_threads);
+            }
+            _supervisor_cv.notify_one();
+            if (_supervisor.joinable()) _supervisor.join();
+            for (auto& t : threads) t.join();
+
+            std::scoped_lock lck(_mtx);
+            join_retired();
+        }
+
+        /**
+         * \brief The number of running workers.
+         */
+        INFO_NODISCARD_JUST
+        std::size_t
+        workers() const noexcept {
+            return _count.load(std::memory_order_relaxed);
+        }
+
+        worker_group(queue_type& queue, handler_type handler, worker_group_options opts = {})
+             : _queue(queue),
+               _handler(std::move(handler)),
+               _opts(opts) {
+            _opts.min_workers = std::max(_opts.min_workers, std::size_t{1});
+            _opts.max_workers = std::max(_opts.max_workers, _opts.min_workers);
+
+            std::scoped_lock lck(_mtx);
+            for (std::size_t i = 0; i < _opts.min_workers; ++i) spawn();
+            _supervisor = std::thread(&worker_group::supervise, this);
+        }
+
+        worker_group(const worker_group& cp) = delete;
+        worker_group& operator=(const worker_group& cp) = delete;
+
+        ~worker_group() noexcept {
+            end();
+        }
+
+    private:
+        using worker_handle = typename std::list<std::thread>::iterator;
+
+        /// Must be called with _mtx held.
+        void
+        spawn() {
+            join_retired();
+            _count.fetch_add(1, std::memory_order_relaxed);
+            auto it = _threads.emplace(_threads.end());
+            *it = std::thread(&worker_group::work, this, it);
+        }
+
+        /// Must be called with _mtx held.
+        void
+        join_retired() {
+            for (auto& t : _retired) t.join();
+            _retired.clear();
+        }
+
+        void
+        maybe_grow() {
+            if (_idle.load(std::memory_order_relaxed) != 0
+                || _queue.size() <= _opts.scale_up_depth
+                || _count.load(std::memory_order_relaxed) >= _opts.max_workers) return;
+
+            std::scoped_lock lck(_mtx);
+            if (!_ending && _count.load(std::memory_order_relaxed) < _opts.max_workers) spawn();
+        }
+
+        /// Starts workers while every one is busy, and elements back up or wait
+        /// too long. The oldest element has waited at least since `stalled_since`:
+        /// the queue was not seen empty, and nothing was popped, since then.
+        void
+        supervise() noexcept {
+            using clock = std::chrono::steady_clock;
+            const auto period = std::max(std::chrono::milliseconds(1), _opts.scale_up_wait / 2);
+            auto taken = _taken.load(std::memory_order_relaxed);
+            auto stalled_since = clock::now();
+
+            std::unique_lock lck(_mtx);
+            while (!_supervisor_cv.wait_for(lck, period, [this] { return _ending; })) {
+                const auto now = clock::now();
+                const auto depth = _queue.size();
+                const auto now_taken = _taken.load(std::memory_order_relaxed);
+                if (depth == 0 || now_taken != taken) {
+                    taken = now_taken;
+                    stalled_since = now;
+                    if (depth <= _opts.scale_up_depth) continue;
+                }
+
+                if (_idle.load(std::memory_order_relaxed) == 0
+                    && (depth > _opts.scale_up_depth || now - stalled_since >= _opts.scale_up_wait)
+                    && _count.load(std::memory_order_relaxed) < _opts.max_workers) {
+                    spawn();
+                    stalled_since = now;
+                }
+            }
+        }
+
+        bool
+        try_retire(worker_handle self) {
+            std::scoped_lock lck(_mtx);
+            if (_ending || _count.load(std::memory_order_relaxed) <= _opts.min_workers) return false;
+
+            _count.fetch_sub(1, std::memory_order_relaxed);
+            // we cannot join ourselves, the next spawn or end() will
+            _retired.splice(_retired.end(), _threads, self);
+            return true;
+        }
+
+        void
+        work(worker_handle self) noexcept {
+            for (;;) {
+                _idle.fetch_add(1, std::memory_order_relaxed);
+                auto elem = _queue.await_pop_for(_opts.idle_timeout);
+                _idle.fetch_sub(1, std::memory_order_relaxed);
+
+                if (!elem) {
+                    if (_queue.ended()) break;
+                    if (try_retire(self)) return;
+                    continue;
+                }
+
+                _taken.fetch_add(1, std::memory_order_relaxed);
+                maybe_grow();
+                _handler(*elem);
+            }
+
+            // the queue has ended, drain it
+            while (auto elem = _queue.try_pop()) _handler(*elem);
+            _count.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        queue_type& _queue;
+        handler_type _handler;
+        worker_group_options _opts;
+
+        std::mutex _mtx;
+        std::list<std::thread> _threads;
+        std::list<std::thread> _retired;
+        std::atomic<std::size_t> _count{0};
+        std::atomic<std::size_t> _idle{0};
+        /// The number of elements popped by the workers.
+        std::atomic<std::size_t> _taken{0};
+        bool _ending = false;
+
+        std::condition_variable _supervisor_cv;
+        std::thread _supervisor;
+    };
+}
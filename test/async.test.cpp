@@ -0,0 +1,51 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/async.hpp>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("async runs the function and returns its result") {
+    auto f = info::async([](int a, int b) { return a * b; }, 6, 7);
+    CHECK(f.get() == 42);
+}
+
+TEST_CASE("async runs on the given executor") {
+    info::thread_pool pool(1);
+    std::thread::id pool_thread;
+    pool.execute([&pool_thread] { pool_thread = std::this_thread::get_id(); });
+
+    auto f = info::async(pool, [] { return std::this_thread::get_id(); });
+    CHECK(f.get() == pool_thread);
+}
+
+TEST_CASE("async stores exceptions in the future") {
+    auto f = info::async([]() -> int { throw std::runtime_error("async failed"); });
+    CHECK_THROWS_WITH(f.get(), Catch::Equals("async failed"));
+}
+
+TEST_CASE("async copies its arguments, and accepts move-only ones") {
+    std::string str = "copied";
+    auto f = info::async([](std::string s, std::unique_ptr<int> p) { return s + std::to_string(*p); },
+                         str,
+                         std::make_unique<int>(1));
+    str.clear();
+    CHECK(f.get() == "copied1");
+}
+
+TEST_CASE("async results can be chained") {
+    info::thread_pool pool(2);
+    std::vector<info::future<int>> fs;
+    for (int i = 0; i < 10; ++i) fs.push_back(info::async(pool, [i] { return i; }));
+    int sum = 0;
+    for (auto& f : fs) sum += f.then([](int x) { return x * 2; }).get();
+    CHECK(sum == 90);
+}
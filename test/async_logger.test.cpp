@@ -0,0 +1,136 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/async_logger.hpp>
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std::literals;
+
+namespace {
+    struct capture {
+        info::async_logger::sink_type
+        sink() {
+            return [this](std::string_view batch) {
+                std::scoped_lock lck(mtx);
+                out.append(batch);
+                ++batches;
+            };
+        }
+
+        std::string
+        text() {
+            std::scoped_lock lck(mtx);
+            return out;
+        }
+
+        std::mutex mtx;
+        std::string out;
+        int batches = 0;
+    };
+}
+
+TEST_CASE("async_logger formats records on flush") {
+    capture cap;
+    info::async_logger log(cap.sink());
+    log.log("answer: {}", 42);
+    log.log("{} + {} = {}", 1.5, -2, "sum");
+    log.log("{{}} {} {}", true, 'x');
+    log.flush();
+
+    CHECK(cap.text() == "answer: 42\n1.5 + -2 = sum\n{} true x\n");
+}
+
+TEST_CASE("async_logger copies string arguments") {
+    capture cap;
+    info::async_logger log(cap.sink());
+    {
+        std::string temporary = "short-lived";
+        log.log("{} {}", temporary, std::string_view(temporary).substr(0, 5));
+    }
+    log.flush();
+
+    CHECK(cap.text() == "short-lived short\n");
+}
+
+TEST_CASE("async_logger writes everything on destruction") {
+    capture cap;
+    {
+        info::async_logger log(cap.sink());
+        for (int i = 0; i < 100; ++i) log.log("{}", i);
+    }
+
+    auto text = cap.text();
+    CHECK(std::count(text.begin(), text.end(), '\n') == 100);
+    CHECK(text.substr(0, 6) == "0\n1\n2\n");
+}
+
+TEST_CASE("async_logger drops records when the buffer is full with the drop policy") {
+    capture cap;
+    info::async_logger_options opts;
+    opts.buffer_size = 256;
+    opts.poll_interval = 1h;
+    info::async_logger log(cap.sink(), opts);
+
+    std::size_t stored = 0;
+    for (int i = 0; i < 100; ++i) stored += log.log("{}", i);
+    log.flush();
+
+    CHECK(stored < 100);
+    CHECK(log.dropped() == 100 - stored);
+}
+
+TEST_CASE("async_logger waits for space with the block policy") {
+    capture cap;
+    info::async_logger_options opts;
+    opts.buffer_size = 256;
+    opts.overflow = info::overflow_policy::block;
+    info::async_logger log(cap.sink(), opts);
+
+    for (int i = 0; i < 1000; ++i) CHECK(log.log("{}", i));
+    log.flush();
+
+    auto text = cap.text();
+    CHECK(std::count(text.begin(), text.end(), '\n') == 1000);
+    CHECK(log.dropped() == 0);
+}
+
+TEST_CASE("async_logger drops records too large for the buffer even with the block policy") {
+    capture cap;
+    info::async_logger_options opts;
+    opts.buffer_size = 256;
+    opts.overflow = info::overflow_policy::block;
+    info::async_logger log(cap.sink(), opts);
+
+    CHECK_FALSE(log.log("{}", std::string(1000, 'x')));
+    CHECK(log.log("{}", "fits"));
+    log.flush();
+
+    CHECK(cap.text() == "fits\n");
+    CHECK(log.dropped() == 1);
+}
+
+TEST_CASE("async_logger accepts records from many threads") {
+    capture cap;
+    {
+        info::async_logger log(cap.sink(), {4096, info::overflow_policy::block, 100us});
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&log, t] {
+                for (int i = 0; i < 250; ++i) log.log("thread {} record {}", t, i);
+            });
+        }
+        for (auto& t : threads) t.join();
+    }
+
+    auto text = cap.text();
+    CHECK(std::count(text.begin(), text.end(), '\n') == 1000);
+    CHECK(text.find("thread 3 record 249\n") != std::string::npos);
+}
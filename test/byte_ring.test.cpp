@@ -0,0 +1,123 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/byte_ring.hpp>
+
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    std::string
+    as_string(const info::byte_ring::span& s) {
+        return {reinterpret_cast<const char*>(s.data()), s.size()};
+    }
+}
+
+TEST_CASE("empty byte_ring peeks an empty span") {
+    info::byte_ring r(64);
+    CHECK(r.empty());
+    CHECK_FALSE(r.peek());
+}
+
+TEST_CASE("byte_ring capacity is rounded up to a power of two") {
+    info::byte_ring r(100);
+    CHECK(r.capacity() == 128);
+}
+
+TEST_CASE("byte_ring records can be written in place and read back") {
+    info::byte_ring r(64);
+    auto buf = r.reserve(5);
+    REQUIRE(buf);
+    REQUIRE(buf.size() == 5);
+    std::memcpy(buf.data(), "hello", 5);
+    r.commit();
+
+    auto rec = r.peek();
+    REQUIRE(rec);
+    CHECK(as_string(rec) == "hello");
+    r.release();
+    CHECK(r.empty());
+}
+
+TEST_CASE("byte_ring commit can shrink the reserved record") {
+    info::byte_ring r(64);
+    auto buf = r.reserve(16);
+    std::memcpy(buf.data(), "abc", 3);
+    r.commit(3);
+
+    CHECK(as_string(r.peek()) == "abc");
+}
+
+TEST_CASE("byte_ring keeps records in order and refuses when full") {
+    info::byte_ring r(64);
+    CHECK(r.try_push("one", 3));
+    CHECK(r.try_push("two", 3));
+    CHECK(r.try_push("three", 5));
+    CHECK(r.try_push("four", 4));
+    CHECK_FALSE(r.try_push("five", 4));
+
+    CHECK(as_string(r.peek()) == "one");
+    r.release();
+    CHECK(r.try_push("five", 4));
+    for (auto expected : {"two", "three", "four", "five"}) {
+        CHECK(as_string(r.peek()) == expected);
+        r.release();
+    }
+    CHECK(r.empty());
+}
+
+TEST_CASE("byte_ring records never wrap around the buffer") {
+    info::byte_ring r(64);
+    REQUIRE(r.try_push("0123456789abcdef", 16)); // 24 bytes
+    auto first = r.peek().data();
+    REQUIRE(r.try_push("0123456789abcdef", 16)); // 48 bytes
+    for (int i = 0; i < 2; ++i) {
+        REQUIRE(r.peek());
+        r.release();
+    }
+
+    // only 16 bytes are left before the end: the record must go to the start
+    REQUIRE(r.try_push("0123456789ab", 12));
+    auto rec = r.peek();
+    CHECK(as_string(rec) == "0123456789ab");
+    CHECK(rec.data() == first);
+    r.release();
+    CHECK(r.empty());
+}
+
+TEST_CASE("byte_ring rejects records larger than max_record_size") {
+    info::byte_ring r(64);
+    CHECK_THROWS_AS((void) r.reserve(r.max_record_size() + 1), std::length_error);
+}
+
+TEST_CASE("byte_ring transfers variable-sized records between threads") {
+    info::byte_ring r(1024);
+    constexpr const int count = 10'000;
+
+    std::thread producer([&r] {
+        std::vector<char> msg;
+        for (int i = 0; i < count; ++i) {
+            msg.assign(static_cast<std::size_t>(i % 200), static_cast<char>(i));
+            while (!r.try_push(msg.data(), msg.size())) std::this_thread::yield();
+        }
+    });
+
+    bool ok = true;
+    for (int i = 0; i < count; ++i) {
+        info::byte_ring::span rec;
+        while (!(rec = r.peek())) std::this_thread::yield();
+        ok &= rec.size() == static_cast<std::size_t>(i % 200);
+        for (auto b : rec) ok &= b == static_cast<std::byte>(i);
+        r.release();
+    }
+    producer.join();
+
+    CHECK(ok);
+    CHECK(r.empty());
+}
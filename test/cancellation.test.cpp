@@ -0,0 +1,109 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/cancellation.hpp>
+#include <info/future.hpp>
+
+#include <atomic>
+#include <thread>
+
+TEST_CASE("cancellation_token observes its source") {
+    info::cancellation_source src;
+    auto token = src.token();
+    CHECK(token.can_be_cancelled());
+    CHECK_FALSE(token.cancelled());
+    CHECK_NOTHROW(token.throw_if_cancelled());
+
+    src.cancel();
+    CHECK(src.cancelled());
+    CHECK(token.cancelled());
+    CHECK_THROWS_AS(token.throw_if_cancelled(), info::operation_cancelled);
+}
+
+TEST_CASE("default cancellation_token is never cancelled") {
+    info::cancellation_token token;
+    CHECK_FALSE(token.can_be_cancelled());
+    CHECK_FALSE(token.cancelled());
+}
+
+TEST_CASE("promise producers can poll for cancellation") {
+    info::cancellation_source src;
+    info::promise<int> p(src.token());
+    auto f = p.get_future();
+
+    std::atomic<bool> started = false;
+    std::thread producer([&p, &started] {
+        started = true;
+        while (!p.cancelled()) std::this_thread::yield();
+        p.set_exception(std::make_exception_ptr(info::operation_cancelled()));
+    });
+    while (!started) std::this_thread::yield();
+    src.cancel();
+    producer.join();
+    CHECK_THROWS_AS(f.get(), info::operation_cancelled);
+}
+
+TEST_CASE("continuations are skipped after cancellation") {
+    info::cancellation_source src;
+    info::promise<int> p(src.token());
+    bool ran = false;
+    auto f = p.get_future()
+                    .then(info::run_inline, [&ran](int x) {
+                        ran = true;
+                        return x;
+                    });
+    src.cancel();
+    p.set_value(1);
+    CHECK_FALSE(ran);
+    CHECK_THROWS_AS(f.get(), info::operation_cancelled);
+}
+
+TEST_CASE("with_cancellation attaches a token to the rest of the chain") {
+    info::cancellation_source src;
+    info::promise<int> p;
+    int ran = 0;
+    auto f = p.get_future()
+                    .then(info::run_inline, [&ran](int x) {
+                        ++ran;
+                        return x;
+                    })
+                    .with_cancellation(src.token())
+                    .then(info::run_inline, [&ran](int x) {
+                        ++ran;
+                        return x;
+                    });
+    src.cancel();
+    p.set_value(1);
+    CHECK(ran == 1);
+    CHECK_THROWS_AS(f.get(), info::operation_cancelled);
+}
+
+TEST_CASE("abandoning a pending future cancels if requested") {
+    info::cancellation_source src(info::cancel_on_abandon);
+    info::promise<int> p(src.token());
+    {
+        auto f = p.get_future().then([](int x) { return x; });
+    }
+    CHECK(p.cancelled());
+}
+
+TEST_CASE("abandoning a future does not cancel by default") {
+    info::cancellation_source src;
+    info::promise<int> p(src.token());
+    { auto f = p.get_future(); }
+    CHECK_FALSE(p.cancelled());
+}
+
+TEST_CASE("dropping a completed future does not cancel") {
+    info::cancellation_source src(info::cancel_on_abandon);
+    info::promise<int> p(src.token());
+    {
+        auto f = p.get_future();
+        p.set_value(1);
+    }
+    CHECK_FALSE(src.cancelled());
+}
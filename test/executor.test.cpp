@@ -0,0 +1,96 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/executor.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+using namespace std::literals;
+
+TEST_CASE("thread_pool runs submitted tasks") {
+    std::atomic<int> sum = 0;
+    {
+        info::thread_pool pool(2);
+        CHECK(pool.size() == 2);
+        for (int i = 1; i <= 100; ++i) pool.execute([&sum, i] { sum += i; });
+    }
+    CHECK(sum == 5050);
+}
+
+TEST_CASE("thread_pool finishes queued tasks on destruction") {
+    std::atomic<int> done = 0;
+    {
+        info::thread_pool pool(1);
+        pool.execute([] { std::this_thread::sleep_for(20ms); });
+        for (int i = 0; i < 10; ++i) pool.execute([&done] { ++done; });
+    }
+    CHECK(done == 10);
+}
+
+TEST_CASE("thread_pool runs every task of a lone submitter while its threads idle") {
+    info::thread_pool pool(4);
+    std::atomic<int> ran = 0;
+    // nothing else is submitted meanwhile: a task missed by the sleeping threads would never run
+    for (int i = 1; i <= 5000; ++i) {
+        pool.execute([&ran] { ++ran; });
+        const auto deadline = std::chrono::steady_clock::now() + 1s;
+        while (ran != i && std::chrono::steady_clock::now() < deadline) std::this_thread::yield();
+        REQUIRE(ran == i);
+        // let every thread go back to sleep now and then
+        if (i % 500 == 0) std::this_thread::sleep_for(5ms);
+    }
+}
+
+TEST_CASE("default_executor is a single shared pool") {
+    CHECK(&info::default_executor() == &info::default_executor());
+
+    std::atomic<bool> ran = false;
+    info::default_executor().execute([&ran] { ran = true; });
+    for (int i = 0; i < 500 && !ran; ++i) std::this_thread::sleep_for(1ms);
+    CHECK(ran);
+}
+
+TEST_CASE("work_stealing_pool runs submitted tasks") {
+    std::atomic<int> sum = 0;
+    {
+        info::work_stealing_pool pool(3);
+        CHECK(pool.size() == 3);
+        for (int i = 1; i <= 100; ++i) pool.execute([&sum, i] { sum += i; });
+    }
+    CHECK(sum == 5050);
+}
+
+TEST_CASE("work_stealing_pool runs tasks spawned by its tasks") {
+    std::atomic<int> done = 0;
+    {
+        info::work_stealing_pool pool(2);
+        for (int i = 0; i < 10; ++i) {
+            pool.execute([&pool, &done] {
+                for (int j = 0; j < 10; ++j) pool.execute([&done] { ++done; });
+            });
+        }
+    }
+    CHECK(done == 100);
+}
+
+TEST_CASE("work_stealing_pool lets idle threads steal queued work") {
+    std::atomic<int> ran = 0;
+    std::atomic<bool> release = false;
+    info::work_stealing_pool pool(2);
+    pool.execute([&pool, &ran, &release] {
+        // queued on this thread's deque, which is blocked: the other thread has to steal it
+        pool.execute([&ran, &release] {
+            ++ran;
+            release = true;
+        });
+        for (int i = 0; i < 1000 && !release; ++i) std::this_thread::sleep_for(1ms);
+    });
+    for (int i = 0; i < 500 && !release; ++i) std::this_thread::sleep_for(1ms);
+    CHECK(release);
+    CHECK(ran == 1);
+}
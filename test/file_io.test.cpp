@@ -0,0 +1,126 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/file_io.hpp>
+
+#ifdef INFO_HAS_FILE_IO
+
+#    include <cstddef>
+#    include <filesystem>
+#    include <fstream>
+#    include <string>
+#    include <system_error>
+#    include <vector>
+
+#    include <fcntl.h>
+#    include <unistd.h>
+
+namespace {
+    struct temp_file {
+        explicit temp_file(const std::string& contents = "") {
+            static int counter = 0;
+            path = std::filesystem::temp_directory_path()
+                   / ("info_file_io_" + std::to_string(::getpid()) + "_" + std::to_string(counter++));
+            std::ofstream(path, std::ios::binary) << contents;
+        }
+
+        ~temp_file() {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+        }
+
+        std::string
+        contents() const {
+            std::ifstream in(path, std::ios::binary);
+            return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+        }
+
+        std::filesystem::path path;
+    };
+
+    std::string
+    to_string(const info::io_buffer& buf) {
+        return {reinterpret_cast<const char*>(buf.data()), buf.size()};
+    }
+
+    info::io_buffer
+    to_buffer(const std::string& str) {
+        return info::io_buffer(str.data(), str.size());
+    }
+}
+
+TEST_CASE("io_service reads and writes files", "[file_io]") {
+    const auto use_io_uring = GENERATE(false, true);
+    info::io_service io(2, use_io_uring);
+    CAPTURE(io.uses_io_uring());
+
+    SECTION("reading by path") {
+        temp_file file("hello, world");
+        CHECK(to_string(io.read(file.path, 7, 5).get()) == "world");
+    }
+
+    SECTION("reading by descriptor") {
+        temp_file file("hello, world");
+        const auto fd = ::open(file.path.c_str(), O_RDONLY);
+        REQUIRE(fd >= 0);
+        CHECK(to_string(io.read(fd, 0, 5).get()) == "hello");
+        ::close(fd);
+    }
+
+    SECTION("reads past the end of the file are short") {
+        temp_file file("hello");
+        CHECK(to_string(io.read(file.path, 2, 100).get()) == "llo");
+        CHECK(io.read(file.path, 10, 100).get().empty());
+    }
+
+    SECTION("writing by path creates the file") {
+        temp_file file;
+        std::filesystem::remove(file.path);
+        CHECK(io.write(file.path, 0, to_buffer("hello")).get() == 5);
+        CHECK(io.write(file.path, 5, to_buffer(", world")).get() == 7);
+        CHECK(file.contents() == "hello, world");
+    }
+
+    SECTION("errors are reported through the future") {
+        CHECK_THROWS_AS(io.read(std::filesystem::path("/nonexistent/info/file"), 0, 1).get(), std::system_error);
+    }
+
+    SECTION("many requests are served in batches") {
+        constexpr const int count = 200;
+        std::vector<temp_file> files;
+        std::vector<info::future<info::io_buffer>> reads;
+        files.reserve(count);
+        for (int i = 0; i < count; ++i) files.emplace_back("file " + std::to_string(i));
+        for (auto& file : files) reads.push_back(io.read(file.path, 0, 64));
+        for (int i = 0; i < count; ++i) CHECK(to_string(reads[static_cast<std::size_t>(i)].take()) == "file " + std::to_string(i));
+    }
+}
+
+TEST_CASE("large mapped reads map the file", "[file_io]") {
+    std::string contents(info::io_service::mmap_threshold + 8192 + 17, 'x');
+    contents[5000] = 'y';
+    temp_file file(contents);
+
+    info::io_service io(1);
+    CHECK_FALSE(io.read(file.path, 0, contents.size()).get().mapped());
+    auto buf = io.read_mapped(file.path, 4999, contents.size()).get();
+    CHECK(buf.mapped());
+    REQUIRE(buf.size() == contents.size() - 4999);
+    CHECK(static_cast<char>(buf[1]) == 'y');
+    CHECK(to_string(buf) == contents.substr(4999));
+}
+
+TEST_CASE("async_write and async_read use the default io_service", "[file_io]") {
+    temp_file file;
+    const auto fd = ::open(file.path.c_str(), O_RDWR);
+    REQUIRE(fd >= 0);
+    CHECK(info::async_write(fd, 0, to_buffer("abcdef")).get() == 6);
+    CHECK(to_string(info::async_read(fd, 3, 3).get()) == "def");
+    ::close(fd);
+}
+
+#endif
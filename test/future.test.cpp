@@ -28,10 +28,16 @@
 // OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <atomic>
 #include <chrono>
 #include <future>
+#include <memory>
+#include <stdexcept>
 #include <string>
 #include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 using namespace std::literals;
 
 #include <info/future.hpp>
@@ -138,3 +144,286 @@ TEST_CASE("not setting value/exception causes promise_broken on promise destruct
     }
     CHECK_THROWS_AS(f.get(), std::future_error);
 }
+
+TEST_CASE("then runs the continuation on the given executor") {
+    info::thread_pool pool(1);
+    std::thread::id pool_thread;
+    pool.execute([&pool_thread] { pool_thread = std::this_thread::get_id(); });
+
+    info::promise<int> p;
+    auto f = p.get_future().then(pool, [](int x) {
+        return std::make_pair(x, std::this_thread::get_id());
+    });
+    p.set_value(42);
+    const auto [val, id] = f.get();
+    CHECK(val == 42);
+    CHECK(id == pool_thread);
+}
+
+TEST_CASE("dropping a chained future does not wait for the continuation") {
+    std::atomic<bool> ran = false;
+    info::promise<int> p;
+    {
+        auto f = p.get_future().then([&ran](int x) {
+            ran = true;
+            return x;
+        });
+    }
+    CHECK_FALSE(ran);
+    p.set_value(1);
+    for (int i = 0; i < 500 && !ran; ++i) std::this_thread::sleep_for(1ms);
+    CHECK(ran);
+}
+
+TEST_CASE("then on a completed future runs the continuation right away") {
+    info::promise<int> p;
+    auto f = p.get_future();
+    p.set_value(20);
+    REQUIRE(f.is_ready());
+
+    const auto caller = std::this_thread::get_id();
+    std::thread::id ran_on;
+    auto f2 = f.then([&ran_on](int x) {
+        ran_on = std::this_thread::get_id();
+        return x + 1;
+    });
+    CHECK(f2.is_ready());
+    CHECK(ran_on == caller);
+    CHECK(f2.get() == 21);
+}
+
+TEST_CASE("run_inline continuations run in the completing thread") {
+    info::promise<int> p;
+    std::thread::id ran_on;
+    auto f = p.get_future()
+                    .then(info::run_inline, [&ran_on](int x) {
+                        ran_on = std::this_thread::get_id();
+                        return x * 2;
+                    })
+                    .then(info::run_inline, [](int x) {
+                        return x + 2;
+                    });
+    CHECK_FALSE(f.is_ready());
+
+    std::thread::id setter;
+    std::thread([&p, &setter] {
+        setter = std::this_thread::get_id();
+        p.set_value(20);
+    }).join();
+    CHECK(f.is_ready());
+    CHECK(ran_on == setter);
+    CHECK(f.get() == 42);
+}
+
+TEST_CASE("wait_for times out on a pending future") {
+    info::promise<int> p;
+    auto f = p.get_future();
+    CHECK_FALSE(f.wait_for(10ms));
+    p.set_value(1);
+    CHECK(f.wait_for(10ms));
+    CHECK(f.wait_until(std::chrono::system_clock::now() - 1s));
+}
+
+TEST_CASE("every waiter is woken on completion") {
+    info::promise<int> p;
+    auto f = p.get_future().share();
+    std::atomic<int> woken = 0;
+    std::vector<std::thread> waiters;
+    for (int i = 0; i < 4; ++i) {
+        waiters.emplace_back([f, &woken] {
+            f.wait();
+            ++woken;
+        });
+    }
+    std::this_thread::sleep_for(10ms);
+    p.set_value(1);
+    for (auto& t : waiters) t.join();
+    CHECK(woken == 4);
+}
+
+TEST_CASE("the shared state is a few words") {
+    CHECK(sizeof(info::impl::state_base) <= 3 * sizeof(void*));
+}
+
+TEST_CASE("then with several continuations fuses them into one step") {
+    info::promise<int> p;
+    info::future<std::string> f = p.get_future().then(
+           [](int x) { return x + 1; },
+           [](int x) { return x * 2; },
+           [](int x) { return std::to_string(x); });
+    p.set_value(20);
+    CHECK(f.get() == "42");
+}
+
+TEST_CASE("fused continuations stop at the first throwing stage") {
+    info::promise<int> p;
+    bool last_ran = false;
+    auto f = p.get_future().then(
+           info::run_inline,
+           [](int x) -> int { throw std::runtime_error(std::to_string(x)); },
+           [&last_ran](int x) {
+               last_ran = true;
+               return x;
+           });
+    p.set_value(7);
+    CHECK_THROWS_WITH(f.get(), Catch::Equals("7"));
+    CHECK_FALSE(last_ran);
+}
+
+TEST_CASE("continuations do not need to be copyable") {
+    info::promise<int> p;
+    auto offset = std::make_unique<int>(22);
+    auto f = p.get_future().then([offset = std::move(offset)](int x) { return x + *offset; });
+    p.set_value(20);
+    CHECK(f.get() == 42);
+}
+
+TEST_CASE("take moves the value out and invalidates the future") {
+    info::promise<std::unique_ptr<int>> p;
+    auto f = p.get_future();
+    p.set_value(std::make_unique<int>(42));
+    auto ptr = f.take();
+    CHECK(*ptr == 42);
+    CHECK_FALSE(f.valid());
+}
+
+TEST_CASE("rvalue get moves the value out") {
+    info::promise<std::vector<int>> p;
+    auto f = p.get_future();
+    p.set_value(std::vector<int>(1000, 1));
+    auto v = std::move(f).get();
+    CHECK(v.size() == 1000);
+}
+
+TEST_CASE("continuations receive the value as an rvalue") {
+    info::promise<std::unique_ptr<int>> p;
+    auto f = p.get_future()
+                    .then([](std::unique_ptr<int>&& ptr) {
+                        *ptr *= 2;
+                        return std::move(ptr);
+                    })
+                    .then(info::run_inline, [](std::unique_ptr<int> ptr) { return *ptr; });
+    p.set_value(std::make_unique<int>(21));
+    CHECK(f.get() == 42);
+}
+
+TEST_CASE("the payload is moved, not copied, down a chain") {
+    struct counted {
+        int* copies;
+        counted(int* copies) : copies(copies) { }
+        counted(const counted& cp) : copies(cp.copies) { ++*copies; }
+        counted(counted&&) noexcept = default;
+        counted& operator=(const counted&) = default;
+        counted& operator=(counted&&) noexcept = default;
+    };
+
+    int copies = 0;
+    info::promise<counted> p;
+    auto f = p.get_future()
+                    .then(info::run_inline, [](counted c) { return c; })
+                    .then(info::run_inline, [](counted c) { return c; });
+    p.set_value(counted(&copies));
+    auto res = f.take();
+    CHECK(res.copies == &copies);
+    CHECK(copies == 0);
+}
+
+TEST_CASE("futures returned by continuations are unwrapped") {
+    info::promise<int> p;
+    info::promise<std::string> inner;
+    auto f = p.get_future().then(info::run_inline, [&inner](int) { return inner.get_future(); });
+    static_assert(std::is_same_v<decltype(f), info::future<std::string>>);
+
+    p.set_value(1);
+    CHECK_FALSE(f.is_ready());
+    inner.set_value("inner");
+    REQUIRE(f.is_ready());
+    CHECK(f.get() == "inner");
+}
+
+TEST_CASE("unwrapped futures chain async steps without blocking a thread") {
+    info::thread_pool pool(1);
+    info::promise<int> p;
+    info::promise<int> inner;
+    auto f = p.get_future()
+                    .then(pool, [&inner](int x) {
+                        return inner.get_future().then(info::run_inline, [x](int y) { return x + y; });
+                    })
+                    .then(pool, [](int sum) { return sum * 2; });
+    p.set_value(1);
+    // the only worker is not stuck waiting for inner
+    info::promise<int> other;
+    auto other_ftr = other.get_future();
+    pool.execute([&other] { other.set_value(10); });
+    CHECK(other_ftr.get() == 10);
+
+    inner.set_value(20);
+    CHECK(f.get() == 42);
+}
+
+TEST_CASE("errors of unwrapped futures are propagated") {
+    info::promise<int> p;
+    info::promise<int> inner;
+    auto f = p.get_future().then(info::run_inline, [&inner](int) { return inner.get_future(); });
+    p.set_value(1);
+    inner.set_exception(std::make_exception_ptr(std::runtime_error("inner")));
+    CHECK_THROWS_WITH(f.get(), Catch::Equals("inner"));
+
+    info::promise<int> q;
+    auto g = q.get_future().then(info::run_inline, [](int) { return info::future<int>(); });
+    q.set_value(1);
+    CHECK_THROWS_AS(g.get(), std::future_error);
+}
+
+TEST_CASE("freed states are reused by the same thread") {
+    auto a = info::impl::allocate_state(64);
+    info::impl::deallocate_state(a);
+    auto b = info::impl::allocate_state(64);
+    CHECK(a == b);
+
+    // a different size class does not get the same block
+    auto c = info::impl::allocate_state(128);
+    CHECK(c != b);
+    info::impl::deallocate_state(b);
+    info::impl::deallocate_state(c);
+}
+
+TEST_CASE("states freed by another thread return to their owner") {
+    // a size no state type has, so the free list starts out empty
+    auto a = info::impl::allocate_state(500);
+    std::thread([a] { info::impl::deallocate_state(a); }).join();
+    auto b = info::impl::allocate_state(500);
+    CHECK(a == b);
+    info::impl::deallocate_state(b);
+}
+
+TEST_CASE("states outlive the thread which allocated them") {
+    info::future<std::string> f;
+    auto raw = static_cast<void*>(nullptr);
+    std::thread([&f, &raw] {
+        info::promise<std::string> p;
+        f = p.get_future().then(info::run_inline, [](std::string&& s) { return s + "!"; });
+        p.set_value("done");
+        raw = info::impl::allocate_state(32);
+    }).join();
+    CHECK(f.get() == "done!");
+    info::impl::deallocate_state(raw);
+}
+
+TEST_CASE("states freed after their owner thread exited are released") {
+    constexpr const int count = 10'000;
+    std::vector<info::future<int>> futures(count);
+    std::thread producer([&futures] {
+        for (int i = 0; i < count; ++i) {
+            info::promise<int> p;
+            futures[static_cast<std::size_t>(i)] = p.get_future();
+            p.set_value(i);
+        }
+    });
+    producer.join();
+
+    long long sum = 0;
+    for (auto& f : futures) sum += f.get();
+    futures.clear();
+    CHECK(sum == static_cast<long long>(count) * (count - 1) / 2);
+}
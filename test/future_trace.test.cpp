@@ -0,0 +1,116 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#define INFO_TRACE_FUTURES
+#include <catch2/catch.hpp>
+
+#include <info/async.hpp>
+#include <info/executor.hpp>
+#include <info/future.hpp>
+
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+    std::size_t
+    count(const std::string& haystack, const std::string& needle) {
+        std::size_t n = 0;
+        for (auto pos = haystack.find(needle); pos != std::string::npos; pos = haystack.find(needle, pos + 1)) ++n;
+        return n;
+    }
+
+    std::string
+    trace() {
+        std::ostringstream ss;
+        CHECK(info::write_future_trace(ss) == 0);
+        return ss.str();
+    }
+}
+
+TEST_CASE("traced futures record their creation and completion") {
+    info::clear_future_trace();
+    info::promise<int> p;
+    auto f = p.get_future();
+    p.set_value(1);
+    CHECK(f.get() == 1);
+
+    const auto json = trace();
+    CHECK(json.rfind(R"({"displayTimeUnit":"ns","traceEvents":[)", 0) == 0);
+    CHECK(count(json, R"("name":"future","cat":"future","ph":"b")") == 1);
+    CHECK(count(json, R"("name":"future","cat":"future","ph":"e")") == 1);
+    CHECK(count(json, R"("name":"set","cat":"future","ph":"n")") == 1);
+}
+
+TEST_CASE("traced continuations record their scheduling and run") {
+    info::clear_future_trace();
+    {
+        info::thread_pool pool(1);
+        info::promise<int> p;
+        auto f = p.get_future()
+                        .then(pool, [](int x) { return x + 1; })
+                        .then(info::run_inline, [](int x) { return x * 2; });
+        p.set_value(20);
+        CHECK(f.get() == 42);
+    } // joins the worker, which may still be recording
+
+    const auto json = trace();
+    CHECK(count(json, R"("name":"future","cat":"future","ph":"b")") == 3);
+    CHECK(count(json, R"("name":"future","cat":"future","ph":"e")") == 3);
+    CHECK(count(json, R"("name":"queued","cat":"future","ph":"b")") == 2);
+    CHECK(count(json, R"("name":"queued","cat":"future","ph":"e")") == 2);
+    CHECK(count(json, R"("name":"continuation","cat":"future","ph":"B")") == 2);
+    CHECK(count(json, R"("name":"continuation","cat":"future","ph":"E")") == 2);
+}
+
+TEST_CASE("async calls are traced") {
+    info::clear_future_trace();
+    {
+        info::thread_pool pool(1);
+        auto f = info::async(pool, [] { return 42; });
+        CHECK(f.get() == 42);
+    }
+
+    const auto json = trace();
+    CHECK(count(json, R"("name":"future","cat":"future","ph":"b")") == 1);
+    CHECK(count(json, R"("name":"queued","cat":"future","ph":"b")") == 1);
+    CHECK(count(json, R"("name":"continuation","cat":"future","ph":"E")") == 1);
+}
+
+TEST_CASE("traced states keep distinct ids when their memory is reused") {
+    info::clear_future_trace();
+    for (int i = 0; i < 2; ++i) {
+        info::promise<int> p;
+        auto f = p.get_future();
+        p.set_value(i);
+        CHECK(f.get() == i);
+    }
+
+    const auto json = trace();
+    const std::string created = R"("name":"future","cat":"future","ph":"b")";
+    const auto first = json.find(created);
+    const auto second = json.find(created, first + 1);
+    REQUIRE(second != std::string::npos);
+    const auto id_of = [&json](std::size_t pos) {
+        const auto id = json.find(R"("id":)", pos);
+        return json.substr(id, json.find('}', id) - id);
+    };
+    CHECK(id_of(first) != id_of(second));
+}
+
+TEST_CASE("the trace buffers of exited threads are reused") {
+    const auto traced_thread = [] {
+        std::thread([] {
+            info::promise<int> p;
+            p.set_value(1);
+        }).join();
+    };
+    traced_thread();
+    const auto buffers = info::impl::trace_thread_ids.load();
+    traced_thread();
+    traced_thread();
+    CHECK(info::impl::trace_thread_ids.load() == buffers);
+}
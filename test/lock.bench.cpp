@@ -0,0 +1,98 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+// Compares the lock types usable as the Lock policy of info::queue.
+// For every lock and thread count it reports the throughput of a bare
+// lock-increment-unlock loop, and of an info::queue using that lock with
+// half of the threads producing and half consuming.
+//
+// usage: utils_lock_bench [max-threads] [ops-per-thread]
+
+#include <info/lock.hpp>
+#include <info/queue.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+    using bench_clock = std::chrono::steady_clock;
+
+    template<class Fn>
+    double
+    run_threads(unsigned threads, Fn fn) {
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+        const auto start = bench_clock::now();
+        for (unsigned i = 0; i < threads; ++i) workers.emplace_back(fn, i);
+        for (auto& w : workers) w.join();
+        return std::chrono::duration<double>(bench_clock::now() - start).count();
+    }
+
+    template<class Lock>
+    double
+    bench_lock(unsigned threads, unsigned long ops) {
+        Lock lock;
+        volatile unsigned long counter = 0;
+        const auto secs = run_threads(threads, [&](unsigned) {
+            for (unsigned long i = 0; i < ops; ++i) {
+                std::scoped_lock lck(lock);
+                counter = counter + 1;
+            }
+        });
+        return static_cast<double>(threads * ops) / secs;
+    }
+
+    template<class Lock>
+    double
+    bench_queue(unsigned threads, unsigned long ops) {
+        const auto producers = std::max(1U, threads / 2);
+        const auto consumers = std::max(1U, threads - producers);
+        const auto total = producers * ops;
+
+        info::queue<unsigned long, Lock> q;
+        const auto secs = run_threads(producers + consumers, [&](unsigned id) {
+            if (id < producers) {
+                for (unsigned long i = 0; i < ops; ++i) q.push(i);
+                return;
+            }
+            // consumers split the elements between them, the last one takes the remainder
+            const auto idx = id - producers;
+            auto mine = total / consumers + (idx == consumers - 1 ? total % consumers : 0);
+            while (mine-- != 0) (void) q.await_pop();
+        });
+        return static_cast<double>(total) / secs;
+    }
+
+    template<class Lock>
+    void
+    report(const char* name, unsigned max_threads, unsigned long ops) {
+        for (unsigned t = 1; t <= max_threads; t *= 2) {
+            std::printf("%-12s %7u %16.0f %16.0f\n",
+                        name,
+                        t,
+                        bench_lock<Lock>(t, ops),
+                        bench_queue<Lock>(t, ops));
+        }
+    }
+}
+
+int
+main(int argc, char** argv) {
+    const auto max_threads = argc > 1
+                                    ? static_cast<unsigned>(std::strtoul(argv[1], nullptr, 10))
+                                    : std::max(1U, std::thread::hardware_concurrency());
+    const auto ops = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200'000UL;
+
+    std::printf("%-12s %7s %16s %16s\n", "lock", "threads", "lock ops/s", "queue ops/s");
+    report<std::mutex>("std::mutex", max_threads, ops);
+    report<info::spinlock>("spinlock", max_threads, ops);
+    report<info::ticket_lock>("ticket_lock", max_threads, ops);
+    report<info::mcs_lock>("mcs_lock", max_threads, ops);
+}
@@ -0,0 +1,76 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/lock.hpp>
+#include <info/queue.hpp>
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+TEMPLATE_TEST_CASE("locks provide mutual exclusion", "",
+                   info::spinlock, info::ticket_lock, info::mcs_lock) {
+    TestType lock;
+    long counter = 0;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&lock, &counter] {
+            for (int j = 0; j < 10'000; ++j) {
+                std::scoped_lock lck(lock);
+                ++counter;
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    CHECK(counter == 40'000);
+}
+
+TEMPLATE_TEST_CASE("try_lock fails on a held lock", "",
+                   info::spinlock, info::ticket_lock, info::mcs_lock) {
+    TestType lock;
+    REQUIRE(lock.try_lock());
+
+    bool acquired = true;
+    std::thread([&lock, &acquired] {
+        acquired = lock.try_lock();
+    }).join();
+    CHECK_FALSE(acquired);
+
+    lock.unlock();
+    CHECK(lock.try_lock());
+    lock.unlock();
+}
+
+TEST_CASE("mcs_locks can be released out of order") {
+    info::mcs_lock a;
+    info::mcs_lock b;
+    a.lock();
+    b.lock();
+    a.unlock();
+    CHECK(a.try_lock());
+    b.unlock();
+    a.unlock();
+}
+
+TEMPLATE_TEST_CASE("queue works with lock policies", "",
+                   info::spinlock, info::ticket_lock, info::mcs_lock) {
+    info::queue<int, TestType> q;
+    std::thread producer([&q] {
+        for (int i = 0; i < 1000; ++i) q.push(i);
+    });
+
+    bool in_order = true;
+    for (int i = 0; i < 1000; ++i) {
+        in_order &= *q.await_pop() == i;
+    }
+    producer.join();
+
+    CHECK(in_order);
+    CHECK(q.try_pop() == nullptr);
+}
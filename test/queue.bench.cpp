@@ -0,0 +1,248 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+// Measures the throughput and handoff latency of info::queue, with each
+// lock policy, against a std::deque guarded by a std::mutex.
+// The matrix covers 1..max-threads producers and consumers (in powers of
+// two), element sizes from 8 to 256 bytes, and steady or bursty producers.
+// Results are written to stdout as a JSON array, one object per run.
+//
+// usage: utils_queue_bench [--max-threads=N] [--ops=N] [--burst=N] [--pause-us=N]
+//   --max-threads  largest number of producers and consumers      [4]
+//   --ops          elements pushed by each producer                [20000]
+//   --burst        elements pushed back-to-back in bursty mode     [64]
+//   --pause-us     pause between bursts in bursty mode, in micros  [50]
+
+#include <info/lock.hpp>
+#include <info/queue.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace {
+    using bench_clock = std::chrono::steady_clock;
+
+    std::int64_t
+    now_ns() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      bench_clock::now().time_since_epoch())
+               .count();
+    }
+
+    /// An element of Size bytes, carrying the time it was pushed.
+    template<std::size_t Size>
+    struct payload {
+        static_assert(Size >= sizeof(std::int64_t));
+
+        std::int64_t _pushed;
+        unsigned char _pad[Size - sizeof(std::int64_t)];
+    };
+
+    template<>
+    struct payload<sizeof(std::int64_t)> {
+        std::int64_t _pushed;
+    };
+
+    /// The baseline: what one would write without info::queue.
+    template<class T>
+    struct deque_queue {
+        void
+        push(T value) {
+            {
+                std::scoped_lock lck(_mtx);
+                _elems.push_back(std::move(value));
+            }
+            _cv.notify_one();
+        }
+
+        std::optional<T>
+        await_pop() {
+            std::unique_lock lck(_mtx);
+            _cv.wait(lck, [this] { return !_elems.empty() || _end; });
+            if (_elems.empty()) return std::nullopt;
+            auto value = std::move(_elems.front());
+            _elems.pop_front();
+            return value;
+        }
+
+        void
+        end() {
+            {
+                std::scoped_lock lck(_mtx);
+                _end = true;
+            }
+            _cv.notify_all();
+        }
+
+    private:
+        std::mutex _mtx;
+        std::condition_variable _cv;
+        std::deque<T> _elems;
+        bool _end = false;
+    };
+
+    enum class load {
+        steady,
+        bursty
+    };
+
+    struct config {
+        unsigned max_threads = 4;
+        std::size_t ops = 20'000;
+        std::size_t burst = 64;
+        std::chrono::microseconds pause{50};
+    };
+
+    struct result {
+        double seconds;
+        std::int64_t p50;
+        std::int64_t p99;
+        std::int64_t p999;
+    };
+
+    std::int64_t
+    percentile(const std::vector<std::int64_t>& sorted, double p) {
+        if (sorted.empty()) return 0;
+        const auto idx = static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1));
+        return sorted[idx];
+    }
+
+    template<class Queue, std::size_t Size>
+    result
+    run(const config& cfg, unsigned producers, unsigned consumers, load mode) {
+        using elem = payload<Size>;
+        Queue q;
+        const auto total = producers * cfg.ops;
+        std::atomic<std::size_t> consumed{0};
+        std::atomic<std::int64_t> finished{0};
+        std::vector<std::vector<std::int64_t>> latencies(consumers);
+        for (auto& l : latencies) l.reserve(total);
+
+        std::vector<std::thread> threads;
+        const auto start = now_ns();
+        for (unsigned i = 0; i < consumers; ++i) {
+            threads.emplace_back([&, i] {
+                auto& lat = latencies[i];
+                while (auto e = q.await_pop()) {
+                    const auto now = now_ns();
+                    lat.push_back(now - e->_pushed);
+                    if (consumed.fetch_add(1, std::memory_order_relaxed) + 1 == total) finished = now;
+                }
+            });
+        }
+        for (unsigned i = 0; i < producers; ++i) {
+            threads.emplace_back([&] {
+                elem e{};
+                for (std::size_t n = 0; n < cfg.ops; ++n) {
+                    if (mode == load::bursty && n != 0 && n % cfg.burst == 0)
+                        std::this_thread::sleep_for(cfg.pause);
+                    e._pushed = now_ns();
+                    q.push(e);
+                }
+            });
+        }
+
+        while (consumed.load(std::memory_order_relaxed) != total) std::this_thread::yield();
+        q.end();
+        for (auto& t : threads) t.join();
+
+        std::vector<std::int64_t> all;
+        all.reserve(total);
+        for (auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+        std::sort(all.begin(), all.end());
+
+        return {static_cast<double>(finished - start) / 1e9,
+                percentile(all, .5),
+                percentile(all, .99),
+                percentile(all, .999)};
+    }
+
+    bool first_result = true;
+
+    template<class Queue, std::size_t Size>
+    void
+    report(const char* name, const config& cfg) {
+        for (unsigned p = 1; p <= cfg.max_threads; p *= 2) {
+            for (unsigned c = 1; c <= cfg.max_threads; c *= 2) {
+                for (auto mode : {load::steady, load::bursty}) {
+                    const auto res = run<Queue, Size>(cfg, p, c, mode);
+                    const auto ops = p * cfg.ops;
+                    std::printf("%s\n  {\"queue\": \"%s\", \"producers\": %u, \"consumers\": %u, "
+                                "\"element_size\": %zu, \"load\": \"%s\", \"ops\": %zu, "
+                                "\"seconds\": %.6f, \"ops_per_sec\": %.0f, "
+                                "\"latency_ns\": {\"p50\": %lld, \"p99\": %lld, \"p999\": %lld}}",
+                                first_result ? "" : ",",
+                                name,
+                                p,
+                                c,
+                                Size,
+                                mode == load::steady ? "steady" : "bursty",
+                                ops,
+                                res.seconds,
+                                static_cast<double>(ops) / res.seconds,
+                                static_cast<long long>(res.p50),
+                                static_cast<long long>(res.p99),
+                                static_cast<long long>(res.p999));
+                    first_result = false;
+                }
+            }
+        }
+    }
+
+    template<std::size_t Size>
+    void
+    report_all(const config& cfg) {
+        report<info::queue<payload<Size>>, Size>("info::queue<std::mutex>", cfg);
+        report<info::queue<payload<Size>, info::spinlock>, Size>("info::queue<info::spinlock>", cfg);
+        report<info::queue<payload<Size>, info::ticket_lock>, Size>("info::queue<info::ticket_lock>", cfg);
+        report<info::queue<payload<Size>, info::mcs_lock>, Size>("info::queue<info::mcs_lock>", cfg);
+        report<deque_queue<payload<Size>>, Size>("std::deque+std::mutex", cfg);
+    }
+
+    bool
+    parse_arg(const char* arg, const char* name, unsigned long& out) {
+        const auto len = std::strlen(name);
+        if (std::strncmp(arg, name, len) != 0 || arg[len] != '=') return false;
+        out = std::strtoul(arg + len + 1, nullptr, 10);
+        return true;
+    }
+}
+
+int
+main(int argc, char** argv) {
+    config cfg;
+    for (int i = 1; i < argc; ++i) {
+        unsigned long val;
+        if (parse_arg(argv[i], "--max-threads", val)) {
+            cfg.max_threads = std::max(1U, static_cast<unsigned>(val));
+        } else if (parse_arg(argv[i], "--ops", val)) {
+            cfg.ops = std::max(1UL, val);
+        } else if (parse_arg(argv[i], "--burst", val)) {
+            cfg.burst = std::max(1UL, val);
+        } else if (parse_arg(argv[i], "--pause-us", val)) {
+            cfg.pause = std::chrono::microseconds(val);
+        } else {
+            std::fprintf(stderr, "unknown argument: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    std::printf("[");
+    report_all<8>(cfg);
+    report_all<64>(cfg);
+    report_all<256>(cfg);
+    std::printf("\n]\n");
+}
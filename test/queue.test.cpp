@@ -126,6 +126,25 @@ TEST_CASE("waiting will return nullptr when the queue end()s") {
     CHECK(r == nullptr);
 }
 
+TEST_CASE("a waiting consumer is woken by every single push") {
+    info::queue<int> q;
+    std::atomic<int> taken = 0;
+    std::thread t([&q, &taken] {
+        while (auto p = q.await_pop()) taken = *p;
+    });
+
+    // each push races the consumer going back to sleep: a lost wakeup leaves it asleep with the element queued
+    for (int i = 1; i <= 20000; ++i) {
+        q.push(i);
+        const auto deadline = std::chrono::steady_clock::now() + 1s;
+        while (taken != i && std::chrono::steady_clock::now() < deadline) std::this_thread::yield();
+        REQUIRE(taken == i);
+    }
+
+    q.end();
+    t.join();
+}
+
 TEST_CASE("queue can handle non-copyable types") {
     info::queue<std::unique_ptr<int>> q;
     q.push(new int{42});
@@ -0,0 +1,86 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/rate_limiter.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+using namespace std::literals;
+
+TEST_CASE("rate_limiter allows a burst then rejects") {
+    info::rate_limiter limiter(1.0, 5); // one token per second
+    for (int i = 0; i < 5; ++i) CHECK(limiter.try_acquire());
+    CHECK_FALSE(limiter.try_acquire());
+}
+
+TEST_CASE("rate_limiter replenishes tokens over time") {
+    info::rate_limiter limiter(100.0, 1); // one token per 10ms
+    REQUIRE(limiter.try_acquire());
+    REQUIRE_FALSE(limiter.try_acquire());
+    std::this_thread::sleep_for(20ms);
+    CHECK(limiter.try_acquire());
+}
+
+TEST_CASE("rate_limiter rejects requests larger than the burst") {
+    info::rate_limiter limiter(1000.0, 4);
+    CHECK_FALSE(limiter.try_acquire(5));
+    CHECK(limiter.try_acquire(4));
+}
+
+TEST_CASE("rate_limiter reservations are spaced by the rate") {
+    info::rate_limiter limiter(10.0, 1); // one token per 100ms
+    const auto now = info::rate_limiter::clock::now();
+    const auto first = limiter.reserve();
+    const auto second = limiter.reserve();
+    const auto third = limiter.reserve();
+
+    CHECK(first <= now + 1ms);
+    CHECK(second - first == 100ms);
+    CHECK(third - second == 100ms);
+}
+
+TEST_CASE("rate_limiter never hands out more than rate allows across threads") {
+    info::rate_limiter limiter(1000.0, 10); // one token per 1ms
+    std::atomic<int> granted = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            while (std::chrono::steady_clock::now() - start < 50ms) granted += limiter.try_acquire();
+        });
+    }
+    for (auto& t : threads) t.join();
+    const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+    CHECK(granted > 0);
+    CHECK(granted <= 10 + static_cast<int>(elapsed.count()) + 1);
+}
+
+TEST_CASE("rate_limited_queue try_push rejects over the rate") {
+    info::queue<int> q;
+    info::rate_limited_queue<int> limited(q, 1.0, 2);
+
+    CHECK(limited.try_push(1));
+    CHECK(limited.try_push(2));
+    CHECK_FALSE(limited.try_push(3));
+    CHECK(q.size() == 2);
+}
+
+TEST_CASE("rate_limited_queue push waits for a token") {
+    info::queue<int> q;
+    info::rate_limited_queue<int> limited(q, 50.0, 1); // one token per 20ms
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 4; ++i) limited.push(i);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    CHECK(elapsed >= 60ms);
+    CHECK(q.size() == 4);
+}
@@ -0,0 +1,159 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/reactor.hpp>
+
+#ifdef INFO_HAS_REACTOR
+
+#    include <array>
+#    include <chrono>
+#    include <thread>
+#    include <utility>
+#    include <vector>
+
+#    include <unistd.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+    struct pipe_fds {
+        pipe_fds() {
+            REQUIRE(::pipe(fds.data()) == 0);
+        }
+
+        ~pipe_fds() {
+            for (auto fd : fds) {
+                if (fd >= 0) ::close(fd);
+            }
+        }
+
+        int
+        read_end() const noexcept {
+            return fds[0];
+        }
+
+        int
+        write_end() const noexcept {
+            return fds[1];
+        }
+
+        void
+        close_write_end() noexcept {
+            ::close(std::exchange(fds[1], -1));
+        }
+
+        void
+        write_byte() const {
+            const char c = 'x';
+            REQUIRE(::write(write_end(), &c, 1) == 1);
+        }
+
+        std::array<int, 2> fds{};
+    };
+}
+
+TEST_CASE("reactor completes futures when descriptors become readable") {
+    info::reactor r;
+    pipe_fds p;
+    auto ftr = r.when_ready(p.read_end(), info::io_events::readable);
+
+    CHECK(r.run_once(0ms) == 0);
+    CHECK_FALSE(ftr.is_ready());
+
+    p.write_byte();
+    CHECK(r.run_once(1s) == 1);
+    REQUIRE(ftr.is_ready());
+    CHECK(info::any_of(ftr.get(), info::io_events::readable));
+}
+
+TEST_CASE("reactor serves readers and writers of the same descriptor") {
+    info::reactor r;
+    pipe_fds p;
+    auto readable = r.when_ready(p.read_end(), info::io_events::readable);
+    auto writable = r.when_ready(p.write_end(), info::io_events::writable);
+    auto readable2 = r.when_ready(p.read_end(), info::io_events::readable);
+
+    CHECK(r.run_once(1s) == 1);
+    CHECK(writable.is_ready());
+    CHECK_FALSE(readable.is_ready());
+
+    p.write_byte();
+    CHECK(r.run_once(1s) == 2);
+    CHECK(readable.is_ready());
+    CHECK(readable2.is_ready());
+}
+
+TEST_CASE("reactor reports hangups to every waiter") {
+    info::reactor r;
+    pipe_fds p;
+    auto ftr = r.when_ready(p.read_end(), info::io_events::priority);
+    p.close_write_end();
+
+    r.run_once(1s);
+    REQUIRE(ftr.is_ready());
+    CHECK(info::any_of(ftr.get(), info::io_events::hangup));
+}
+
+TEST_CASE("forgotten descriptors cancel their waiters") {
+    info::reactor r;
+    pipe_fds p;
+    auto ftr = r.when_ready(p.read_end(), info::io_events::readable);
+    r.forget(p.read_end());
+    CHECK_THROWS_AS(ftr.get(), info::operation_cancelled);
+}
+
+TEST_CASE("tasks posted to the reactor run on its thread") {
+    info::reactor r;
+    std::thread loop([&r] { r.run(); });
+
+    info::promise<std::thread::id> p;
+    auto ftr = p.get_future();
+    r.execute([&p] { p.set_value(std::this_thread::get_id()); });
+    CHECK(ftr.get() == loop.get_id());
+
+    r.stop();
+    loop.join();
+    CHECK(r.stopped());
+}
+
+TEST_CASE("continuations can wait on the reactor again") {
+    info::reactor r;
+    pipe_fds p;
+    int reads = 0;
+    auto ftr = r.when_ready(p.read_end(), info::io_events::readable)
+                      .then(info::run_inline, [&](info::io_events) {
+                          char c;
+                          REQUIRE(::read(p.read_end(), &c, 1) == 1);
+                          ++reads;
+                          return r.when_ready(p.read_end(), info::io_events::readable);
+                      });
+    p.write_byte();
+    r.run_once(1s);
+    CHECK(reads == 1);
+    CHECK_FALSE(ftr.is_ready());
+
+    p.write_byte();
+    r.run_once(1s);
+    CHECK(ftr.is_ready());
+}
+
+TEST_CASE("one reactor thread serves many descriptors") {
+    constexpr const int count = 256;
+    info::reactor r;
+    std::vector<pipe_fds> pipes(count);
+    std::vector<info::future<info::io_events>> ftrs;
+    for (auto& p : pipes) ftrs.push_back(r.when_ready(p.read_end(), info::io_events::readable));
+
+    std::thread loop([&r] { r.run(); });
+    for (auto& p : pipes) p.write_byte();
+    for (auto& f : ftrs) CHECK(info::any_of(f.get(), info::io_events::readable));
+
+    r.stop();
+    loop.join();
+}
+
+#endif
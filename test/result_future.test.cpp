@@ -0,0 +1,157 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/result_future.hpp>
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+
+namespace {
+    enum class parse_error {
+        empty,
+        not_a_number,
+    };
+}
+
+TEST_CASE("result_future delivers values") {
+    info::result_promise<int, parse_error> p;
+    auto ftr = p.get_future();
+    std::thread([&p] { p.set_value(42); }).join();
+
+    auto res = ftr.expect();
+    REQUIRE(res);
+    CHECK(*res == 42);
+    CHECK_FALSE(ftr.valid());
+}
+
+TEST_CASE("result_future delivers errors without throwing") {
+    info::result_promise<int, std::error_code> p;
+    auto ftr = p.get_future();
+    p.set_error(std::make_error_code(std::errc::timed_out));
+
+    auto res = ftr.expect();
+    REQUIRE_FALSE(res);
+    CHECK(res.error() == std::errc::timed_out);
+}
+
+TEST_CASE("result_future continuations are skipped on error") {
+    std::atomic<int> calls{0};
+    info::result_promise<std::string, parse_error> p;
+    auto ftr = p.get_future()
+                      .then(info::run_inline, [&calls](std::string&& s) {
+                          ++calls;
+                          return s.size();
+                      })
+                      .then(info::run_inline, [&calls](std::size_t n) {
+                          ++calls;
+                          return n * 2;
+                      });
+    p.set_error(parse_error::empty);
+
+    auto res = ftr.expect();
+    REQUIRE_FALSE(res);
+    CHECK(res.error() == parse_error::empty);
+    CHECK(calls == 0);
+}
+
+TEST_CASE("result_future continuations may fail by returning an expected") {
+    info::result_promise<std::string, parse_error> p;
+    auto ftr = p.get_future()
+                      .then(info::run_inline, [](std::string&& s) -> info::expected<int, parse_error> {
+                          if (s.empty()) return info::USE_UNEXPECTED<parse_error>{parse_error::empty};
+                          if (s.find_first_not_of("0123456789") != std::string::npos)
+                              return info::USE_UNEXPECTED<parse_error>{parse_error::not_a_number};
+                          return std::stoi(s);
+                      })
+                      .then(info::run_inline, [](int n) { return n + 1; });
+
+    SECTION("with a value") {
+        p.set_value("41");
+        CHECK(ftr.take() == 42);
+    }
+    SECTION("with an error") {
+        p.set_value("forty-one");
+        auto res = ftr.expect();
+        REQUIRE_FALSE(res);
+        CHECK(res.error() == parse_error::not_a_number);
+    }
+}
+
+TEST_CASE("result_future continuations run on executors") {
+    info::result_promise<int, parse_error> p;
+    auto ftr = p.get_future().then([](int n) {
+        return std::to_string(n);
+    });
+    std::thread([&p] { p.set_value(7); }).join();
+    CHECK(ftr.take() == "7");
+}
+
+TEST_CASE("result_future moves move-only values through the chain") {
+    info::result_promise<std::unique_ptr<int>, parse_error> p;
+    auto ftr = p.get_future().then(info::run_inline, [](std::unique_ptr<int>&& ptr) {
+        *ptr += 1;
+        return std::move(ptr);
+    });
+    p.set_value(std::make_unique<int>(41));
+    CHECK(*ftr.take() == 42);
+}
+
+TEST_CASE("result_future moves errors through the chain") {
+    struct counted_error {
+        explicit counted_error(int* copies) noexcept
+             : copies{copies} { }
+        counted_error(const counted_error& cp) noexcept
+             : copies{cp.copies} { ++*copies; }
+        counted_error(counted_error&&) noexcept = default;
+
+        int* copies;
+    };
+
+    int copies = 0;
+    info::result_promise<int, counted_error> p;
+    auto ftr = p.get_future()
+                      .then(info::run_inline, [&copies](int) -> info::expected<int, counted_error> {
+                          return info::USE_UNEXPECTED<counted_error>{counted_error{&copies}};
+                      })
+                      .then(info::run_inline, [](int n) { return n + 1; });
+    p.set_value(42);
+
+    auto res = ftr.expect();
+    REQUIRE_FALSE(res);
+    CHECK(std::move(res).error().copies == &copies);
+    CHECK(copies == 0);
+}
+
+TEST_CASE("result_future take throws the error") {
+    info::result_promise<int, parse_error> p;
+    auto ftr = p.get_future();
+    p.set_error(parse_error::empty);
+    CHECK_THROWS_AS(ftr.take(), parse_error);
+}
+
+TEST_CASE("result_future still propagates exceptions") {
+    info::result_promise<int, parse_error> p;
+    auto ftr = p.get_future().then(info::run_inline, [](int) -> int {
+        throw std::runtime_error("fail");
+    });
+    p.set_value(1);
+    CHECK_THROWS_WITH(ftr.expect(), Catch::Equals("fail"));
+}
+
+TEST_CASE("dropped result_promise breaks its future") {
+    info::result_future<int, parse_error> ftr;
+    {
+        info::result_promise<int, parse_error> p;
+        ftr = p.get_future();
+    }
+    CHECK_THROWS_AS(ftr.expect(), std::future_error);
+}
@@ -0,0 +1,84 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/future.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std::literals;
+
+TEST_CASE("shared_future copies share the same value") {
+    info::promise<std::string> p;
+    info::shared_future<std::string> f = p.get_future().share();
+    auto g = f;
+    std::thread([&p] { p.set_value("config"); }).join();
+
+    CHECK(f.get() == "config");
+    CHECK(&f.get() == &g.get());
+}
+
+TEST_CASE("shared_future can be read from many threads") {
+    info::promise<std::vector<int>> p;
+    info::shared_future<std::vector<int>> f(p.get_future());
+
+    std::atomic<int> sum = 0;
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([f, &sum] {
+            for (int x : f.get()) sum += x;
+        });
+    }
+    p.set_value(std::vector<int>{1, 2, 3});
+    for (auto& t : readers) t.join();
+    CHECK(sum == 24);
+}
+
+TEST_CASE("shared_future runs every continuation attached to it") {
+    info::promise<int> p;
+    auto f = p.get_future().share();
+    auto plus = f.then(info::run_inline, [](const int& x) { return x + 1; });
+    auto times = f.then([](const int& x) { return x * 2; });
+    auto str = f.then(info::default_executor(), [](const int& x) { return std::to_string(x); });
+    CHECK(f.valid());
+
+    p.set_value(21);
+    CHECK(plus.get() == 22);
+    CHECK(times.get() == 42);
+    CHECK(str.get() == "21");
+}
+
+TEST_CASE("shared_future continuations run in attachment order") {
+    info::promise<int> p;
+    auto f = p.get_future().share();
+    std::vector<int> order;
+    auto a = f.then(info::run_inline, [&order](int) { order.push_back(1); return 0; });
+    auto b = f.then(info::run_inline, [&order](int) { order.push_back(2); return 0; });
+    auto c = f.then(info::run_inline, [&order](int) { order.push_back(3); return 0; });
+    p.set_value(0);
+    CHECK(order == std::vector<int>{1, 2, 3});
+}
+
+TEST_CASE("shared_future rethrows the exception on every get") {
+    info::promise<int> p;
+    auto f = p.get_future().share();
+    auto cont = f.then([](int x) { return x; });
+    p.set_exception(std::make_exception_ptr(std::runtime_error("bad config")));
+
+    CHECK_THROWS_WITH(f.get(), Catch::Equals("bad config"));
+    CHECK_THROWS_WITH(f.get(), Catch::Equals("bad config"));
+    CHECK_THROWS_WITH(cont.get(), Catch::Equals("bad config"));
+}
+
+TEST_CASE("shared_future of an invalid future is invalid") {
+    info::future<int> f;
+    info::shared_future<int> sf(std::move(f));
+    CHECK_FALSE(sf.valid());
+    CHECK_THROWS_AS(sf.get(), std::future_error);
+}
@@ -0,0 +1,115 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/future.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+    using info::impl::allocate_state;
+    using info::impl::deallocate_state;
+    using info::impl::state_cache;
+
+    // no state type is this large, so the tests have the size class to themselves
+    constexpr const std::size_t test_size = 30 * state_cache::granule;
+    const std::size_t test_class = state_cache::size_class(test_size);
+
+    template<class Fn>
+    void
+    on_new_thread(Fn fn) {
+        std::thread(fn).join();
+    }
+
+    struct alignas(128) over_aligned {
+        int value;
+    };
+}
+
+TEST_CASE("state caches reuse the blocks freed on the owner thread") {
+    on_new_thread([] {
+        const auto ptr = allocate_state(test_size);
+        deallocate_state(ptr);
+        CHECK(info::impl::this_thread_state_cache->cached(test_class) == 1);
+
+        CHECK(allocate_state(test_size) == ptr);
+        deallocate_state(ptr);
+    });
+}
+
+TEST_CASE("state caches reuse the blocks freed on other threads") {
+    on_new_thread([] {
+        const auto ptr = allocate_state(test_size);
+        on_new_thread([ptr] { deallocate_state(ptr); });
+        CHECK(info::impl::this_thread_state_cache->cached(test_class) == 0);
+
+        CHECK(allocate_state(test_size) == ptr);
+        deallocate_state(ptr);
+    });
+}
+
+TEST_CASE("state caches keep at most INFO_STATE_POOL_CAPACITY blocks") {
+    on_new_thread([] {
+        std::vector<void*> blocks;
+        for (std::size_t i = 0; i < state_cache::capacity + 10; ++i) blocks.push_back(allocate_state(test_size));
+        for (std::size_t i = 0; i < 5; ++i) {
+            on_new_thread([ptr = blocks.back()] { deallocate_state(ptr); });
+            blocks.pop_back();
+        }
+        for (auto ptr : blocks) deallocate_state(ptr);
+        CHECK(info::impl::this_thread_state_cache->cached(test_class) == state_cache::capacity);
+
+        // the remotely freed blocks come back only once the list is empty, and the list still does not grow
+        blocks.clear();
+        for (std::size_t i = 0; i < state_cache::capacity; ++i) blocks.push_back(allocate_state(test_size));
+        CHECK(info::impl::this_thread_state_cache->cached(test_class) == 0);
+        blocks.push_back(allocate_state(test_size));
+        CHECK(info::impl::this_thread_state_cache->cached(test_class) == 4);
+        for (auto ptr : blocks) deallocate_state(ptr);
+        CHECK(info::impl::this_thread_state_cache->cached(test_class) == state_cache::capacity);
+    });
+}
+
+TEST_CASE("states may outlive the thread which allocated them") {
+    // run under AddressSanitizer, this also checks that nothing leaks or is freed twice
+    std::vector<void*> blocks;
+    std::vector<info::future<int>> futures;
+    on_new_thread([&blocks, &futures] {
+        for (int i = 0; i < 10; ++i) blocks.push_back(allocate_state(test_size));
+        // freed remotely while the owner still runs
+        on_new_thread([ptr = blocks.back()] { deallocate_state(ptr); });
+        blocks.pop_back();
+
+        for (int i = 0; i < 10; ++i) {
+            info::promise<int> p;
+            futures.push_back(p.get_future());
+            p.set_value(i);
+        }
+    });
+
+    for (auto ptr : blocks) deallocate_state(ptr);
+    for (int i = 0; i < 10; ++i) CHECK(futures[static_cast<std::size_t>(i)].take() == i);
+    futures.clear();
+}
+
+TEST_CASE("over-aligned states are not pooled") {
+    on_new_thread([] {
+        info::promise<over_aligned> p;
+        auto ftr = p.get_future();
+        p.set_value(over_aligned{42});
+        CHECK(ftr.take().value == 42);
+
+        const auto state = new info::impl::future_state<over_aligned>;
+        CHECK(reinterpret_cast<std::uintptr_t>(state) % alignof(over_aligned) == 0);
+        delete state;
+
+        // the only states allocated on this thread went to the global allocator
+        CHECK(info::impl::this_thread_state_cache == nullptr);
+    });
+}
@@ -0,0 +1,38 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#define INFO_STATE_POOL_CAPACITY 0
+#include <catch2/catch.hpp>
+
+#include <info/executor.hpp>
+#include <info/future.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST_CASE("states go to the global allocator without state caches") {
+    info::promise<int> p;
+    auto ftr = p.get_future().then(info::run_inline, [](int n) { return n + 1; });
+    std::thread([&p] { p.set_value(41); }).join();
+
+    CHECK(ftr.take() == 42);
+    CHECK(info::impl::this_thread_state_cache == nullptr);
+}
+
+TEST_CASE("states are freed on any thread without state caches") {
+    std::atomic<int> sum = 0;
+    {
+        info::thread_pool pool(2);
+        std::vector<std::thread> producers;
+        for (int i = 1; i <= 100; ++i) {
+            info::promise<int> p;
+            (void) p.get_future().then(pool, [&sum](int n) { return sum += n; });
+            producers.emplace_back([p = std::move(p), i]() mutable { p.set_value(i); });
+        }
+        for (auto& t : producers) t.join();
+    }
+    CHECK(sum == 5050);
+}
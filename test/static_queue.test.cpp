@@ -0,0 +1,83 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/static_queue.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+namespace {
+    constexpr int
+    fifo_in_constexpr() {
+        info::static_queue<int, 4> q;
+        q.push(1);
+        q.push(2);
+        q.push(3);
+        const auto first = q.pop();
+        q.push(4);
+        q.push(5); // wraps around
+        const auto full = q.full() && !q.push(6);
+        return first * 1000 + q.pop() * 100 + q.front() * 10 + full;
+    }
+}
+
+TEST_CASE("static_queue is usable in constant expressions") {
+    static_assert(fifo_in_constexpr() == 1231);
+}
+
+TEST_CASE("static_queue pops in insertion order across the wrap") {
+    info::static_queue<std::string, 2> q;
+    for (int i = 0; i < 10; ++i) {
+        REQUIRE(q.push(std::to_string(i)));
+        CHECK(q.pop() == std::to_string(i));
+    }
+    CHECK(q.empty());
+}
+
+TEST_CASE("static_queue refuses elements when full") {
+    info::static_queue<int, 2> q;
+    CHECK(q.emplace(1));
+    CHECK(q.emplace(2));
+    CHECK_FALSE(q.emplace(3));
+    CHECK(q.size() == 2);
+
+    int x = 0;
+    CHECK(q.try_pop(x));
+    CHECK(x == 1);
+}
+
+TEST_CASE("static_queue holds move-only types") {
+    info::static_queue<std::unique_ptr<int>, 4> q;
+    q.push(std::make_unique<int>(42));
+    CHECK(*q.pop() == 42);
+}
+
+TEST_CASE("static_queue bulk copies wrap around the buffer") {
+    info::static_queue<int, 8> q;
+    const int in[] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+    CHECK(q.push_n(in, 6) == 6);
+
+    int out[9] = {};
+    CHECK(q.pop_n(out, 4) == 4);
+    CHECK(out[3] == 4);
+
+    CHECK(q.push_n(in, 9) == 6); // only 6 places left, 4 of them before the end
+    CHECK(q.size() == 8);
+    CHECK(q.pop_n(out, 9) == 8);
+    const int expected[] = {5, 6, 1, 2, 3, 4, 5, 6};
+    CHECK(std::equal(expected, expected + 8, out));
+}
+
+TEST_CASE("static_queue bulk copies work for non-trivial types") {
+    info::static_queue<std::string, 4> q;
+    const std::string in[] = {"a", "b", "c"};
+    CHECK(q.push_n(in, 3) == 3);
+    std::string out[3];
+    CHECK(q.pop_n(out, 3) == 3);
+    CHECK(out[2] == "c");
+}
@@ -0,0 +1,132 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/task.hpp>
+
+#ifdef INFO_HAS_COROUTINES
+
+#    include <memory>
+#    include <stdexcept>
+#    include <string>
+#    include <thread>
+
+namespace {
+    info::task<int>
+    forty_two() {
+        co_return 42;
+    }
+
+    info::task<int>
+    add_one(info::future<int> f) {
+        co_return co_await std::move(f) + 1;
+    }
+
+    info::task<std::string>
+    describe(info::future<int> f) {
+        const auto x = co_await add_one(std::move(f));
+        co_return std::to_string(x);
+    }
+
+    info::task<int>
+    fail() {
+        throw std::runtime_error("task failed");
+        co_return 0;
+    }
+
+    info::task<int>
+    sum_to(int n) {
+        if (n == 0) co_return 0;
+        co_return n + co_await sum_to(n - 1);
+    }
+}
+
+TEST_CASE("task does not start until it is started or awaited") {
+    bool ran = false;
+    auto t = [](bool& ran) -> info::task<int> {
+        ran = true;
+        co_return 1;
+    }(ran);
+    CHECK_FALSE(ran);
+    auto f = info::start(std::move(t));
+    CHECK(ran);
+    CHECK(f.get() == 1);
+}
+
+TEST_CASE("task result is available through start") {
+    CHECK(info::start(forty_two()).get() == 42);
+}
+
+TEST_CASE("task can await futures fulfilled by other threads") {
+    info::promise<int> p;
+    auto f = info::start(describe(p.get_future()));
+    CHECK_FALSE(f.is_ready());
+    std::thread([&p] { p.set_value(41); }).join();
+    CHECK(f.get() == "42");
+}
+
+TEST_CASE("task can await already completed futures") {
+    info::promise<int> p;
+    p.set_value(1);
+    CHECK(info::start(add_one(p.get_future())).get() == 2);
+}
+
+TEST_CASE("task can await shared futures") {
+    info::promise<std::string> p;
+    auto sf = p.get_future().share();
+    auto t = [](info::shared_future<std::string> sf) -> info::task<std::size_t> {
+        const auto& str = co_await sf;
+        co_return str.size();
+    };
+    auto f1 = info::start(t(sf));
+    auto f2 = info::start(t(sf));
+    p.set_value("four");
+    CHECK(f1.get() == 4);
+    CHECK(f2.get() == 4);
+}
+
+TEST_CASE("task exceptions are propagated") {
+    CHECK_THROWS_WITH(info::start(fail()).get(), Catch::Equals("task failed"));
+
+    info::promise<int> p;
+    auto f = info::start(add_one(p.get_future()));
+    p.set_exception(std::make_exception_ptr(std::runtime_error("upstream")));
+    CHECK_THROWS_WITH(f.get(), Catch::Equals("upstream"));
+}
+
+TEST_CASE("deeply nested tasks do not overflow the stack") {
+    CHECK(info::start(sum_to(10000)).get() == 50005000);
+}
+
+TEST_CASE("task can be started on an executor") {
+    info::thread_pool pool(1);
+    std::thread::id pool_thread;
+    pool.execute([&pool_thread] { pool_thread = std::this_thread::get_id(); });
+
+    auto t = []() -> info::task<std::thread::id> {
+        co_return std::this_thread::get_id();
+    };
+    CHECK(info::start(pool, t()).get() == pool_thread);
+}
+
+TEST_CASE("resume_on moves the coroutine to the executor") {
+    info::thread_pool pool(1);
+    auto t = [](info::executor& exec) -> info::task<bool> {
+        const auto before = std::this_thread::get_id();
+        co_await info::resume_on(exec);
+        co_return before != std::this_thread::get_id();
+    };
+    CHECK(info::start(t(pool)).get());
+}
+
+TEST_CASE("task values may be move-only") {
+    auto t = []() -> info::task<std::unique_ptr<int>> {
+        co_return std::make_unique<int>(42);
+    };
+    CHECK(*info::start(t()).take() == 42);
+}
+
+#endif
@@ -0,0 +1,179 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/task_graph.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("task_graph runs nodes after their predecessors") {
+    std::mutex mtx;
+    std::vector<int> order;
+    auto record = [&](int i) {
+        return [&, i] {
+            std::scoped_lock lck(mtx);
+            order.push_back(i);
+        };
+    };
+
+    // 0 -> {1, 2} -> 3
+    info::task_graph graph;
+    const auto a = graph.add(record(0));
+    const auto b = graph.add(record(1));
+    const auto c = graph.add(record(2));
+    const auto d = graph.add(record(3));
+    graph.precede(a, b);
+    graph.precede(a, c);
+    graph.precede(b, d);
+    graph.precede(c, d);
+
+    info::work_stealing_pool pool(2);
+    auto stats = graph.run(pool).get();
+    CHECK(stats.nodes == 4);
+    REQUIRE(order.size() == 4);
+    CHECK(order.front() == 0);
+    CHECK(order.back() == 3);
+}
+
+TEST_CASE("task_graph reports the critical path") {
+    // two independent chains: 10ms + 10ms, and 5ms
+    info::task_graph graph;
+    const auto a = graph.add([] { std::this_thread::sleep_for(10ms); });
+    const auto b = graph.add([] { std::this_thread::sleep_for(10ms); });
+    graph.add([] { std::this_thread::sleep_for(5ms); });
+    graph.precede(a, b);
+
+    info::work_stealing_pool pool(2);
+    auto stats = graph.run(pool).get();
+    CHECK(stats.critical_path >= 20ms);
+    CHECK(stats.busy_time >= 25ms);
+    CHECK(stats.wall_time >= stats.critical_path);
+}
+
+TEST_CASE("task_graph can be run repeatedly") {
+    std::atomic<int> runs{0};
+    info::task_graph graph;
+    std::vector<info::task_graph::node_id> nodes;
+    for (int i = 0; i < 50; ++i) {
+        nodes.push_back(graph.add([&runs] { ++runs; }));
+        // a wide fan-out from the first node, with a join every ten nodes
+        if (i > 0) graph.precede(nodes[0], nodes.back());
+        if (i > 0 && i % 10 == 0) graph.precede(nodes[static_cast<std::size_t>(i - 1)], nodes.back());
+    }
+
+    info::work_stealing_pool pool(3);
+    for (int i = 0; i < 20; ++i) {
+        CHECK(graph.run(pool).get().nodes == 50);
+    }
+    CHECK(runs == 50 * 20);
+}
+
+TEST_CASE("task_graph runs on the default pool") {
+    std::atomic<int> runs{0};
+    info::task_graph graph;
+    graph.precede(graph.add([&runs] { ++runs; }), graph.add([&runs] { ++runs; }));
+    graph.run().wait();
+    CHECK(runs == 2);
+}
+
+TEST_CASE("an empty task_graph completes right away") {
+    info::task_graph graph;
+    auto ftr = graph.run();
+    CHECK(ftr.is_ready());
+    CHECK(ftr.get().nodes == 0);
+}
+
+TEST_CASE("task_graph propagates exceptions and skips the rest") {
+    std::atomic<bool> throws{true};
+    std::atomic<int> ran{0};
+    info::task_graph graph;
+    const auto a = graph.add([&throws, &ran] {
+        ++ran;
+        if (throws) throw std::runtime_error("fail");
+    });
+    const auto b = graph.add([&ran] { ++ran; });
+    graph.precede(a, b);
+
+    auto ftr = graph.run();
+    CHECK_THROWS_WITH(ftr.get(), Catch::Equals("fail"));
+    CHECK(ran == 1);
+
+    // the failure does not stick to the next run
+    const auto c = graph.add([&ran] { ++ran; });
+    graph.precede(b, c);
+    throws = false;
+    ran = 0;
+    CHECK(graph.run().get().nodes == 3);
+    CHECK(ran == 3);
+}
+
+namespace {
+    /// Runs tasks in the calling thread, until it refuses to take more.
+    struct refusing_executor final : info::executor {
+        void
+        execute(task_type task) override {
+            if (accepted == limit) throw std::runtime_error("refused");
+            ++accepted;
+            task();
+        }
+
+        explicit refusing_executor(int limit) noexcept
+             : limit(limit) { }
+
+        const int limit;
+        int accepted = 0;
+    };
+}
+
+TEST_CASE("task_graph fails the run if the executor refuses a node") {
+    std::atomic<int> ran{0};
+    info::task_graph graph;
+    const auto a = graph.add([&ran] { ++ran; });
+    const auto b = graph.add([&ran] { ++ran; });
+    const auto c = graph.add([&ran] { ++ran; });
+    const auto d = graph.add([&ran] { ++ran; });
+    graph.precede(a, b);
+    graph.precede(a, c);
+    graph.precede(b, d);
+    graph.precede(c, d);
+
+    // a is taken, then one of b and c is refused
+    refusing_executor exec(1);
+    auto ftr = graph.run(exec);
+    CHECK_THROWS_WITH(ftr.get(), Catch::Equals("refused"));
+    CHECK(ran == 1);
+    CHECK_FALSE(graph.running());
+}
+
+TEST_CASE("task_graph refuses cycles") {
+    info::task_graph graph;
+    const auto a = graph.add([] { });
+    const auto b = graph.add([] { });
+    graph.precede(a, b);
+    graph.precede(b, a);
+    CHECK_THROWS_AS(graph.run(), std::invalid_argument);
+    CHECK_FALSE(graph.running());
+    CHECK_THROWS_AS(graph.precede(a, 2), std::out_of_range);
+}
+
+TEST_CASE("task_graph may be run again from its future's continuation") {
+    std::atomic<int> runs{0};
+    info::task_graph graph;
+    graph.add([&runs] { ++runs; });
+
+    auto ftr = graph.run().then(info::run_inline, [&graph](info::task_graph_stats&&) {
+        return graph.run();
+    });
+    ftr.get();
+    CHECK(runs == 2);
+}
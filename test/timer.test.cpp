@@ -0,0 +1,186 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/timer.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("timer_service runs callbacks no earlier than their deadline") {
+    info::promise<std::chrono::steady_clock::time_point> p;
+    auto ftr = p.get_future();
+
+    // declared last, so its thread is joined before the promise is destroyed
+    info::timer_service timers;
+    const auto deadline = std::chrono::steady_clock::now() + 20ms;
+    auto handle = timers.schedule_at(deadline, [&p] {
+        p.set_value(std::chrono::steady_clock::now());
+    });
+    CHECK(ftr.get() >= deadline);
+}
+
+TEST_CASE("timer_service never runs callbacks early") {
+    std::atomic<int> early = 0;
+    std::atomic<int> fired = 0;
+    {
+        info::timer_service timers;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 400; ++i) {
+            // deadlines between ticks, where rounding matters
+            const auto tp = start + std::chrono::microseconds(250 + 97 * i);
+            timers.schedule_at(tp, [tp, &early, &fired] {
+                if (std::chrono::steady_clock::now() < tp) ++early;
+                ++fired;
+            });
+        }
+        for (int i = 0; i < 2000 && fired != 400; ++i) std::this_thread::sleep_for(1ms);
+    }
+    CHECK(fired == 400);
+    CHECK(early == 0);
+}
+
+TEST_CASE("timer_service runs callbacks in deadline order") {
+    std::mutex mtx;
+    std::vector<int> order;
+    info::promise<int> done;
+    auto ftr = done.get_future();
+
+    auto record = [&](int i) {
+        return [&, i] {
+            std::scoped_lock lck(mtx);
+            order.push_back(i);
+            if (order.size() == 3) done.set_value(0);
+        };
+    };
+    info::timer_service timers;
+    auto h3 = timers.schedule_after(30ms, record(3));
+    auto h1 = timers.schedule_after(5ms, record(1));
+    auto h2 = timers.schedule_after(15ms, record(2));
+
+    ftr.wait();
+    CHECK(order == std::vector<int>{1, 2, 3});
+}
+
+TEST_CASE("cancelled timers do not run") {
+    std::atomic<int> runs{0};
+    info::promise<int> p;
+    auto ftr = p.get_future();
+
+    info::timer_service timers;
+    auto cancelled = timers.schedule_after(5ms, [&runs] { ++runs; });
+    CHECK(cancelled.cancel());
+    CHECK_FALSE(cancelled.cancel());
+
+    auto h = timers.schedule_after(10ms, [&p] { p.set_value(1); });
+    ftr.wait();
+    CHECK(runs == 0);
+    CHECK_FALSE(h.cancel());
+}
+
+TEST_CASE("timers past the first level of the wheel are redistributed") {
+    info::promise<std::chrono::steady_clock::time_point> p;
+    auto ftr = p.get_future();
+
+    info::timer_service timers;
+    const auto deadline = std::chrono::steady_clock::now() + 150ms;
+    auto handle = timers.schedule_at(deadline, [&p] {
+        p.set_value(std::chrono::steady_clock::now());
+    });
+    CHECK(ftr.get() >= deadline);
+}
+
+TEST_CASE("timer_service handles many outstanding timers") {
+    constexpr const int count = 100'000;
+    std::atomic<int> fired{0};
+    info::promise<int> done;
+    auto ftr = done.get_future();
+
+    std::vector<info::timer_handle> handles;
+    handles.reserve(count);
+    info::timer_service timers;
+    for (int i = 0; i < count; ++i) {
+        handles.push_back(timers.schedule_after(10ms + std::chrono::milliseconds(i % 50), [&] {
+            if (++fired == count / 2) done.set_value(0);
+        }));
+        // cancel every odd timer
+        if (i % 2 == 1) handles.back().cancel();
+    }
+
+    ftr.wait();
+    CHECK(fired == count / 2);
+}
+
+TEST_CASE("destroying the timer_service drops its pending timers") {
+    std::atomic<int> runs{0};
+    {
+        info::timer_service timers;
+        auto h = timers.schedule_after(1h, [&runs] { ++runs; });
+    }
+    CHECK(runs == 0);
+}
+
+TEST_CASE("with_deadline completes with the value if it arrives in time") {
+    info::promise<int> p;
+    auto ftr = info::with_deadline(p.get_future(), std::chrono::steady_clock::now() + 1h);
+    CHECK_FALSE(ftr.is_ready());
+    p.set_value(42);
+    CHECK(ftr.get() == 42);
+}
+
+TEST_CASE("with_deadline propagates exceptions arriving in time") {
+    info::promise<int> p;
+    auto ftr = info::with_timeout(p.get_future(), 1h);
+    p.set_exception(std::make_exception_ptr(std::runtime_error("fail")));
+    CHECK_THROWS_WITH(ftr.get(), Catch::Equals("fail"));
+}
+
+TEST_CASE("with_deadline fails with deadline_exceeded if the value is late") {
+    info::promise<int> p;
+    auto ftr = info::with_timeout(p.get_future(), 10ms);
+    CHECK_THROWS_AS(ftr.get(), info::deadline_exceeded);
+    p.set_value(42); // too late, ignored
+}
+
+TEST_CASE("with_deadline works with a custom timer_service") {
+    info::timer_service timers;
+    info::promise<std::string> p;
+    auto ftr = info::with_timeout(p.get_future(), 5ms, timers);
+    CHECK_THROWS_AS(ftr.get(), info::deadline_exceeded);
+}
+
+namespace {
+    std::atomic<int> live_copies = 0;
+
+    /// Copied out of the input, so the input's copy lives as long as the input's state.
+    struct counted {
+        counted() noexcept { ++live_copies; }
+        counted(const counted&) noexcept { ++live_copies; }
+        ~counted() noexcept { --live_copies; }
+    };
+}
+
+TEST_CASE("with_deadline releases its states once the value arrives in time") {
+    info::timer_service timers;
+    {
+        info::future<counted> ftr;
+        {
+            info::promise<counted> p;
+            ftr = info::with_timeout(p.get_future(), 1h, timers);
+            p.set_value(counted{});
+        }
+        (void) ftr.get();
+    }
+    // the timer is still pending, but holds neither the input nor the result
+    CHECK(live_copies == 0);
+}
@@ -0,0 +1,76 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/when_all.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+using namespace std::literals;
+
+TEST_CASE("when_all of futures completes with all values") {
+    info::promise<int> p1;
+    info::promise<std::string> p2;
+    auto all = info::when_all(p1.get_future(), p2.get_future());
+    CHECK_FALSE(all.is_ready());
+
+    p2.set_value("meaning");
+    CHECK_FALSE(all.is_ready());
+    std::thread([&p1] { p1.set_value(42); }).join();
+
+    REQUIRE(all.is_ready());
+    CHECK(all.get() == std::make_tuple(42, "meaning"s));
+}
+
+TEST_CASE("when_all accepts chained futures") {
+    info::promise<int> p;
+    auto all = info::when_all(p.get_future().then(info::run_inline, [](int x) { return x * 2; }));
+    p.set_value(21);
+    CHECK(std::get<0>(all.get()) == 42);
+}
+
+TEST_CASE("when_all fails with the exception of the first failing future") {
+    info::promise<int> p1, p2, p3;
+    auto all = info::when_all(p1.get_future(), p2.get_future(), p3.get_future());
+    p3.set_exception(std::make_exception_ptr(std::runtime_error("third")));
+    p2.set_exception(std::make_exception_ptr(std::runtime_error("second")));
+    p1.set_value(1);
+    CHECK_THROWS_WITH(all.get(), Catch::Equals("second"));
+}
+
+TEST_CASE("when_all of a range keeps the order of the range") {
+    std::vector<info::promise<int>> ps(8);
+    std::vector<info::future<int>> fs;
+    for (auto& p : ps) fs.push_back(p.get_future());
+    auto all = info::when_all(fs);
+
+    std::vector<std::thread> threads;
+    for (int i = 7; i >= 0; --i) {
+        threads.emplace_back([&ps, i] { ps[static_cast<std::size_t>(i)].set_value(i * i); });
+    }
+    for (auto& t : threads) t.join();
+
+    CHECK(all.get() == std::vector<int>{0, 1, 4, 9, 16, 25, 36, 49});
+}
+
+TEST_CASE("when_all of an empty range is ready immediately") {
+    std::vector<info::future<int>> fs;
+    auto all = info::when_all(fs);
+    REQUIRE(all.is_ready());
+    CHECK(all.get().empty());
+}
+
+TEST_CASE("when_all of already completed futures is ready immediately") {
+    info::promise<int> p1, p2;
+    p1.set_value(1);
+    p2.set_value(2);
+    auto all = info::when_all(p1.get_future(), p2.get_future());
+    REQUIRE(all.is_ready());
+    CHECK(all.get() == std::make_tuple(1, 2));
+}
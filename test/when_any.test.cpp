@@ -0,0 +1,66 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/when_any.hpp>
+
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST_CASE("when_any completes with the first future to complete") {
+    info::promise<int> p1, p2, p3;
+    auto any = info::when_any(p1.get_future(), p2.get_future(), p3.get_future());
+    CHECK_FALSE(any.is_ready());
+
+    std::thread([&p2] { p2.set_value(42); }).join();
+    REQUIRE(any.is_ready());
+    p1.set_value(1);
+    p3.set_value(3);
+
+    const auto res = any.get();
+    CHECK(res.index == 1);
+    CHECK(res.value == 42);
+}
+
+TEST_CASE("when_any completes with the exception if the first future fails") {
+    info::promise<int> p1, p2;
+    auto any = info::when_any(p1.get_future(), p2.get_future());
+    p1.set_exception(std::make_exception_ptr(std::runtime_error("first")));
+    p2.set_value(2);
+    CHECK_THROWS_WITH(any.get(), Catch::Equals("first"));
+}
+
+TEST_CASE("when_any of a range reports the position in the range") {
+    std::vector<info::promise<int>> ps(4);
+    std::vector<info::future<int>> fs;
+    for (auto& p : ps) fs.push_back(p.get_future());
+    auto any = info::when_any(fs);
+
+    ps[2].set_value(2);
+    const auto res = any.get();
+    CHECK(res.index == 2);
+    CHECK(res.value == 2);
+    // the rest complete after the result is gone
+    ps[0].set_value(0);
+    ps[1].set_value(1);
+    ps[3].set_value(3);
+}
+
+TEST_CASE("when_any outlives its result if the other futures complete later") {
+    info::promise<int> p1, p2;
+    {
+        auto any = info::when_any(p1.get_future(), p2.get_future());
+        p1.set_value(1);
+        CHECK(any.get().value == 1);
+    }
+    p2.set_value(2);
+}
+
+TEST_CASE("when_any of an empty range throws") {
+    std::vector<info::future<int>> fs;
+    CHECK_THROWS_AS(info::when_any(fs), std::invalid_argument);
+}
@@ -0,0 +1,97 @@
+/* InfoUtils project
+ * Copyright (c) 2021 bodand
+ * Licensed under the BSD 3-Clause license
+ */
+
+#include <catch2/catch.hpp>
+
+#include <info/worker_group.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+using namespace std::literals;
+
+TEST_CASE("worker_group processes every element") {
+    info::queue<int> q;
+    std::atomic<int> sum = 0;
+    info::worker_group<int> group(q, [&sum](int& x) { sum += x; });
+
+    for (int i = 1; i <= 100; ++i) q.push(i);
+    group.end();
+
+    CHECK(sum == 5050);
+}
+
+TEST_CASE("worker_group drains the queue on end") {
+    info::queue<int> q;
+    for (int i = 0; i < 50; ++i) q.push(i);
+
+    std::atomic<int> count = 0;
+    info::worker_group<int> group(q, [&count](int&) {
+        std::this_thread::sleep_for(1ms);
+        ++count;
+    });
+    group.end();
+
+    CHECK(count == 50);
+    CHECK(q.size() == 0);
+}
+
+TEST_CASE("worker_group starts workers when the queue backs up") {
+    info::queue<int> q;
+    info::worker_group_options opts;
+    opts.min_workers = 1;
+    opts.max_workers = 4;
+    info::worker_group<int> group(q, [](int&) { std::this_thread::sleep_for(10ms); }, opts);
+    REQUIRE(group.workers() == 1);
+
+    for (int i = 0; i < 20; ++i) q.push(i);
+    std::this_thread::sleep_for(50ms);
+
+    CHECK(group.workers() > 1);
+    CHECK(group.workers() <= 4);
+    group.end();
+}
+
+TEST_CASE("worker_group retires idle workers") {
+    info::queue<int> q;
+    info::worker_group_options opts;
+    opts.min_workers = 1;
+    opts.max_workers = 4;
+    opts.idle_timeout = 20ms;
+    info::worker_group<int> group(q, [](int&) { std::this_thread::sleep_for(5ms); }, opts);
+
+    for (int i = 0; i < 20; ++i) q.push(i);
+    while (q.size() != 0) std::this_thread::sleep_for(1ms);
+    std::this_thread::sleep_for(200ms);
+
+    CHECK(group.workers() == 1);
+    q.push(1);
+    group.end();
+}
+
+TEST_CASE("worker_group starts workers when elements wait behind stuck handlers") {
+    info::queue<int> q;
+    info::worker_group_options opts;
+    opts.min_workers = 1;
+    opts.max_workers = 2;
+    opts.scale_up_wait = 5ms;
+    std::atomic<bool> release = false;
+    std::atomic<int> done = 0;
+    info::worker_group<int> group(q, [&release, &done](int& x) {
+        while (x == 0 && !release) std::this_thread::sleep_for(1ms);
+        ++done;
+    }, opts);
+
+    q.push(0); // blocks the only worker
+    while (q.size() != 0) std::this_thread::sleep_for(1ms);
+    // not deeper than scale_up_depth, but left waiting
+    q.push(1);
+    for (int i = 0; i < 1000 && done == 0; ++i) std::this_thread::sleep_for(1ms);
+
+    CHECK(done == 1);
+    CHECK(group.workers() == 2);
+    release = true;
+    group.end();
+}